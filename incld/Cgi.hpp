@@ -27,6 +27,8 @@ class Cgi
 
 		int							_stdinFd;
 		int							_stdoutFd;
+		uint32_t					_stdinEvents;
+		uint32_t					_stdoutEvents;
 		pid_t						_pid;
 		bool						_headersParsed;
 
@@ -51,6 +53,11 @@ class Cgi
 		bool				init();
 		int					reapChild();
 		int					killChild();
+		void				terminate();
+
+		void				closeStdin();
+		void				closeStdout();
+		void				updateEpollInterest(ClientState state);
 
 		int					getStdinFd();
 		int					getStdoutFd();
@@ -6,6 +6,7 @@
 
 #include <sys/stat.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
 
 #include "webserv.hpp"
 #include "IEpollFdOwner.hpp"
@@ -14,8 +15,14 @@
 #include "Server.hpp"
 #include "PostRequestHandler.hpp"
 #include "Program.hpp"
+#include "TimerWheel.hpp"
+#include "Task.hpp"
+#include "HttpRequestParser.hpp"
+#include "ReadBuffer.hpp"
 
-extern Time g_current_time;
+#define CLIENT_MAX_RETAINED_BUFFER (64 * 1024)
+
+extern thread_local Time g_current_time;
 
 enum class ClientState
 {
@@ -28,6 +35,15 @@ enum class ClientState
 	READING_CGI_OUTPUT,
 };
 
+enum class TimerPhase
+{
+	HEADER,
+	BODY,
+	KEEPALIVE,
+	SEND,
+	CGI,
+};
+
 enum class FileType
 {
 	REGULAR,
@@ -41,25 +57,30 @@ class Client : public IEpollFdOwner
 		int					_clientFd;
 
 		std::string			_cgiBuffer;
-		Time				_lastActivity;
-		std::string			_buffer;
+		TimerNode			_timer;
+		TimerNode			_idleNode;
+		TimerPhase			_timerPhase;
+		ReadBuffer			_buffer;
+		HttpRequestParser	_parser;
 
 		std::string			_responseBuffer;
 		size_t				_responseOffset;
 		ClientState			_state;
+		uint32_t			_events;
 
-		FdClientMap			&_clientsMap;
-		FdEpollOwnerMap		&_handlersMap;
-		IpPort				&_ipPort;
+		FdClientTable			&_clientsTable;
+		FdEpollOwnerTable		&_handlersTable;
+		IpPort				*_ipPort;
 		ServerPtr			_ownerServer;
 
-		std::string			_httpMethod;
+		HttpMethod			_httpMethod;
 		std::string			_httpPath;
 		std::string			_query;
 		std::string			_httpVersion;
 		long				_contentLen;
 		bool				_chunked;
 		bool				_keepAlive;
+		bool				_expectContinue;
 		std::string			_hostHeader;
 		std::string			_contentType;
 		std::string			_multipartBoundary;
@@ -76,49 +97,94 @@ class Client : public IEpollFdOwner
 
 		Cgi					_cgi;
 		PostRequestHandler	_postHandler;
-		bool				_isTimeout;
+
+		Task				_sendTask;
+		Task				_cgiInputTask;
+		FdEvent				_socketEvent;
+		FdEvent				_cgiStdinEvent;
+		bool				_sendFailed;
+		bool				_inputClosed;
+		int					_queuedResponses;
+		size_t				_chargedMemory;
+		bool				_readPending;
+		bool				_corked;
+		bool				_noDelay;
+		bool				_sendInFlight;
+		size_t				_receivedBytes;
+
+		bool	readInput(size_t bufferCap);
+		bool	takeReceived();
+		void	receive(const Completion &completion);
+		void	chargeMemory();
+		ssize_t	sendChunk();
+		ssize_t	sendWithInlineFile(size_t pending, size_t fileLeft);
+		ssize_t	sendHeadersAndFile(size_t pending, size_t fileLeft);
+		void	setCork(bool on);
+		Task	sendResponseTask();
+		Task	sendResponseCompletionTask();
+		void	submitSend();
+		Task	writeCgiInputTask();
+		void	finishResponse();
 	public:
 		Client(int clientFd, IpPort &owner);
 		~Client();
 
+		void	reuse(int clientFd, IpPort &owner);
+		void	recycle();
+		void	detach();
+
 		int		getFd();
 		void	handleEpollEvent(epoll_event &ev, int eventFd);
+		void	handleCompletion(Completion &completion, int eventFd);
 
-		void	sendResponse();
 		bool	readRequest();
+		void	readAhead();
+		void	chargeBuffers();
+		void	releaseBuffers();
+
+		bool	canQueueResponse();
+		void	queueResponse();
+		bool	flushQueuedResponses();
+		bool	hasQueuedResponses();
 
 		void	closeFile();
 		void	openFile(std::string &filePath);
 
 		void	handleCgiStdoutEvent();
-		void	handleCgiStdinEvent();
 		bool	parseCgiOutput();
 		void	resetRequestData();
+		void	updateEpollInterest();
+		void	setNoDelay(bool on);
 
-		Time			getLastActivity();
-		void			setLastActivity(Time t);
+		void			armTimer(TimerPhase phase);
+		void			refreshTimer();
+		TimerPhase		getTimerPhase();
 
-		std::string&	getBuffer();
-		void			setBuffer(const std::string &v);
+		ReadBuffer&		getBuffer();
+		HttpRequestParser&	getParser();
 
 		std::string&	getResponseBuffer();
 		void			setResponseBuffer(const std::string &v);
+		void			appendResponse(std::string_view v);
 
 		size_t			getResponseOffset();
 		void			setResponseOffset(size_t v);
 
+		bool			isInputClosed();
+
 		ClientState		getState();
 		void			setState(ClientState s);
+		uint32_t		getEpollEvents();
 
-		FdClientMap&		getClientsMap();
-		FdEpollOwnerMap&	getHandlersMap();
+		FdClientTable&		getClientsTable();
+		FdEpollOwnerTable&	getHandlersTable();
 		IpPort&			getIpPort();
 
 		ServerPtr&		getOwnerServer();
 		void			setOwnerServer(const ServerPtr &srv);
 
-		std::string&	getHttpMethod();
-		void			setHttpMethod(const std::string &v);
+		HttpMethod		getHttpMethod();
+		void			setHttpMethod(HttpMethod v);
 
 		std::string&	getHttpPath();
 		void			setHttpPath(const std::string &v);
@@ -138,6 +204,9 @@ class Client : public IEpollFdOwner
 		bool			isKeepAlive();
 		void			setKeepAlive(bool v);
 
+		bool			isExpectingContinue();
+		void			setExpectContinue(bool v);
+
 		std::string&	getHostHeader();
 		void			setHostHeader(const std::string &v);
 
@@ -168,9 +237,6 @@ class Client : public IEpollFdOwner
 		int				getFileSize();
 		void			setFileSize(int sz);
 
-		bool			isTimeout();
-		void			setTimeout(bool Timeout);
-
 		Cgi&			getCgi();
 		PostRequestHandler&	getPostRequestHandler();
 };
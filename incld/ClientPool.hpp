@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "webserv.hpp"
+
+// Per-worker free list of Client objects. Closed connections hand their
+// Client back here instead of freeing it, so accept/close churn reuses
+// objects (and their buffers) without touching the allocator. At most
+// highWaterMark idle clients are kept; the rest are deleted.
+class ClientPool
+{
+	private:
+		std::vector<Client*>	_free;
+		size_t					_highWaterMark;
+	public:
+		ClientPool(size_t highWaterMark);
+		~ClientPool();
+
+		ClientPool(const ClientPool&) = delete;
+		ClientPool& operator=(const ClientPool&) = delete;
+
+		ClientPtr	acquire(int clientFd, IpPort &owner);
+		void		release(Client *client);
+
+		size_t		getIdleCount();
+};
@@ -6,17 +6,10 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <thread>
 
 #include "webserv.hpp"
-
-#include "Client.hpp"
-#include "IpPort.hpp"
-
-enum class HttpMethod {
-	GET = 1,
-	POST = 2,
-	DELETE = 4,
-};
+#include "HttpTokens.hpp"
 
 struct Location {
 	std::string path;
@@ -29,11 +22,20 @@ struct Location {
 	std::string redirectUrl;
 	bool		isRedirected = false;
 	bool		isCgi = false;
+	int			tcpNodelay = -1;	// -1 takes the server's setting
 };
 
+// Socket options belong to the address, not the server: only one listen
+// directive per address may set them.
 struct ListenConfig {
 	std::string host = "0.0.0.0";
 	int port = -1;
+	int backlog = DEFAULT_LISTEN_BACKLOG;
+	int deferAccept = 0;
+	int fastOpen = 0;
+	int rcvBuf = 0;
+	int sndBuf = 0;
+	bool hasOptions = false;
 	std::string getAddressPort() const { return host + ":" + std::to_string(port); }
 };
 
@@ -41,6 +43,9 @@ struct ServerConfig {
 	std::vector<ListenConfig> listens;
 	std::string serverName;
 	size_t clientMaxBodySize = 1000000;
+	int maxConnections = 0;
+	bool tcpNopush = false;
+	bool tcpNodelay = false;
 	std::map<int, std::string> errorPages;
 	std::vector<Location> locations;
 
@@ -48,19 +53,60 @@ struct ServerConfig {
 	int getPort() const { return listens.empty() ? -1 : listens[0].port; }
 };
 
+struct GlobalConfig {
+	int workerThreads = 1;
+	bool workerCpuAffinity = false;
+	bool edgeTriggered = false;
+	int clientHeaderTimeout = 60;
+	int clientBodyTimeout = 60;
+	int keepaliveTimeout = 75;
+	int sendTimeout = 60;
+	int cgiTimeout = 60;
+	int maxEvents = DEFAULT_MAX_EVENTS;
+	int acceptBudget = DEFAULT_ACCEPT_BUDGET;
+	std::string eventBackend = "epoll";
+	int clientPoolSize = DEFAULT_CLIENT_POOL_SIZE;
+	int logLevel = LOG_LEVEL_INFO;
+	int maxConnections = 0;
+	bool evictIdleKeepalive = false;
+	int overloadThresholdMs = 0;
+	int overloadRetryAfter = DEFAULT_OVERLOAD_RETRY_AFTER;
+	int maxRequestLine = DEFAULT_MAX_REQUEST_LINE;
+	int maxHeaderLine = DEFAULT_MAX_HEADER_LINE;
+	int maxHeaderSize = DEFAULT_MAX_HEADER_SIZE;
+	int maxConnectionBuffer = DEFAULT_MAX_CONNECTION_BUFFER;
+	size_t maxBufferMemory = 0;
+};
+
+// Servers built from one load of the config file. Never modified once
+// published: a reload builds a new snapshot, and clients keep the
+// ServerPtr of the snapshot their request was routed with.
+struct ConfigSnapshot {
+	ServerDeq servers;
+	AddrPortServersMap addrPortServers;
+	AddrPortListenMap listenConfigs;
+	uint64_t generation = 0;
+};
+
 class ConfigParser {
 private:
+	GlobalConfig _globalConfig;
 	std::vector<ServerConfig> _serverConfigs;
 
 	void parseServerBlock(std::ifstream& file, ServerConfig& config);
 	void parseLocationBlock(std::ifstream& file, Location& location);
 	void parseServerDirective(const std::string& line, ServerConfig& config);
+	void parseGlobalDirective(const std::string& line, GlobalConfig& config);
 	void parseLocationDirective(const std::string& line, Location& location);
+	void parseListenOption(const std::string& option, ListenConfig& listen);
 	void fulfillDefaultErrorPages(ServerConfig& config);
 
 	std::string trim(const std::string& str);
 	std::vector<std::string> split(const std::string& str, char delimiter);
 	int parseHttpMethods(const std::string& methods);
+	int parsePositiveInt(const std::string& value, const std::string& directive);
+	size_t parseSize(const std::string& value, const std::string& directive);
+	int parseTimeout(const std::string& value);
 
 public:
 	ConfigParser() = default;
@@ -68,5 +114,6 @@ public:
 
 	void parseConfig(const std::string& configFile);
 	const std::vector<ServerConfig>& getServerConfigs() const;
-	void createServersAndIpPortsFromConfig(Program &program);
+	const GlobalConfig& getGlobalConfig() const;
+	void createServersFromConfig(ConfigSnapshot &snapshot);
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Connection counters shared by every worker: one instance for the whole
+// process and one per listen address. A slot is reserved before accept()
+// and released when the connection closes, so a limit can't be overshot
+// by workers admitting at the same time.
+struct ConnectionStats
+{
+	std::atomic<int>		active{0};
+	std::atomic<uint64_t>	accepted{0};
+	std::atomic<uint64_t>	rejected{0};
+	std::atomic<uint64_t>	evicted{0};
+	std::atomic<uint64_t>	paused{0};
+	std::atomic<uint64_t>	shed{0};
+
+	// A limit of 0 means unlimited
+	bool	tryAcquire(int limit)
+	{
+		int	current = active.load(std::memory_order_relaxed);
+
+		do
+		{
+			if (limit > 0 && current >= limit)
+				return false;
+		}
+		while (!active.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+		return true;
+	}
+
+	void	release()
+	{
+		active.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	bool	hasCapacity(int limit) const
+	{
+		return limit <= 0 || active.load(std::memory_order_relaxed) < limit;
+	}
+};
+
+using	ConnectionStatsPtr = std::shared_ptr<ConnectionStats>;
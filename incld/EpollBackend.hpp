@@ -0,0 +1,46 @@
+#pragma once
+
+#include <unistd.h>
+
+#include "webserv.hpp"
+#include "IEventBackend.hpp"
+#include "CustomException.hpp"
+#include "utils.hpp"
+
+#define DEFAULT_EPOLL_SIZE 10
+
+struct PendingInterest
+{
+	uint32_t	events = 0;
+	uint64_t	token = 0;
+	bool		dirty = false;
+};
+
+// Interest changes are queued per fd and applied right before the next
+// epoll_wait, so a connection that changes state several times in one
+// loop iteration, or closes in it, costs at most one epoll_ctl.
+class EpollBackend : public IEventBackend
+{
+	private:
+		int								_epollFd;
+		std::vector<PendingInterest>	_pending;
+		std::vector<int>				_dirtyFds;
+		std::vector<Completion>			_completions;
+
+		void	control(int op, int fd, uint32_t events, uint64_t token);
+		void	dropPending(int fd);
+	public:
+		EpollBackend();
+		~EpollBackend();
+
+		void	add(int fd, uint32_t events, uint64_t token);
+		void	modify(int fd, uint32_t events, uint64_t token);
+		void	remove(int fd);
+		void	release(int fd);
+		void	flush();
+		int		wait(std::vector<epoll_event> &events, int timeoutMs);
+
+		bool	isCompletionBased();
+		void	send(int fd, const char *data, size_t length, const FileChunk *chunk);
+		std::vector<Completion>	&getCompletions();
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "CustomException.hpp"
+
+// Dense table indexed by file descriptor. The kernel hands out the lowest
+// free fd, so a vector stays compact and lookups need no hashing.
+// Each slot carries a generation bumped on every emplace; event tokens
+// (generation << 32 | fd) issued for a previous owner of a reused fd are
+// then recognised as stale instead of reaching the new owner.
+// Growing the table on emplace invalidates references into it.
+template <typename T>
+class FdTable
+{
+	private:
+		struct Slot
+		{
+			T			value{};
+			uint32_t	generation = 0;
+			bool		used = false;
+		};
+
+		std::vector<Slot>	_slots;
+		size_t				_size = 0;
+
+		bool	isValid(int fd) const
+		{
+			return fd >= 0 && static_cast<size_t>(fd) < _slots.size() && _slots[fd].used;
+		}
+	public:
+		T	*find(int fd)
+		{
+			return isValid(fd) ? &_slots[fd].value : nullptr;
+		}
+
+		T	&at(int fd)
+		{
+			if (!isValid(fd))
+				THROW("Unknown fd in FdTable");
+			return _slots[fd].value;
+		}
+
+		void	emplace(int fd, T value)
+		{
+			if (fd < 0)
+				THROW("Negative fd in FdTable");
+			if (static_cast<size_t>(fd) >= _slots.size())
+				_slots.resize(fd + 1);
+			Slot	&slot = _slots[fd];
+			if (!slot.used)
+				++_size;
+			slot.value = std::move(value);
+			slot.used = true;
+			++slot.generation;
+		}
+
+		void	erase(int fd)
+		{
+			if (!isValid(fd))
+				return;
+			_slots[fd].used = false;
+			_slots[fd].value = T{};
+			--_size;
+		}
+
+		uint64_t	getToken(int fd)
+		{
+			if (!isValid(fd))
+				THROW("Unknown fd in FdTable");
+			return (static_cast<uint64_t>(_slots[fd].generation) << 32) | static_cast<uint32_t>(fd);
+		}
+
+		T	*findByToken(uint64_t token, int &fd)
+		{
+			fd = static_cast<int>(token & 0xffffffff);
+			if (!isValid(fd) || _slots[fd].generation != static_cast<uint32_t>(token >> 32))
+				return nullptr;
+			return &_slots[fd].value;
+		}
+
+		template <typename F>
+		void	forEach(F func)
+		{
+			for (size_t fd = 0; fd < _slots.size(); ++fd)
+				if (_slots[fd].used)
+					func(static_cast<int>(fd), _slots[fd].value);
+		}
+
+		size_t	size() const
+		{
+			return _size;
+		}
+};
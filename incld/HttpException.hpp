@@ -5,6 +5,18 @@
 
 #define EXCEPT_BUFF_SIZE 128
 #define THROW_HTTP(statusCode, msg) throw HttpException((statusCode), __FILE__, __LINE__, (msg))
+#define HTTP_ERROR(statusCode, msg) HttpError{(statusCode), (msg)}
+
+// A request the server refuses, returned rather than thrown on the request
+// path: a scanner's 404 should cost a branch, not an unwind. A status code
+// of 0 means there is no error.
+struct HttpError
+{
+	int			statusCode = 0;
+	const char	*message = "";
+
+	explicit operator bool() const { return statusCode != 0; }
+};
 
 class HttpException : public std::exception
 {
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+#include "webserv.hpp"
+#include "HttpException.hpp"
+#include "HttpTokens.hpp"
+
+enum class ParseState
+{
+	REQUEST_LINE,
+	HEADERS,
+	DONE,
+	FAILED,
+};
+
+// Offsets into the connection buffer; they survive the buffer growing
+struct Span
+{
+	size_t	offset = 0;
+	size_t	length = 0;
+};
+
+// What the server uses of a request head, as views into the connection
+// buffer. Valid until the buffer is next modified.
+struct RequestHead
+{
+	HttpMethod			method = HttpMethod::UNKNOWN;
+	std::string_view	target;
+	std::string_view	version;
+	std::string_view	host;
+	std::string_view	contentType;
+	std::string_view	transferEncoding;
+	std::string_view	connection;
+	std::string_view	expect;
+	size_t				contentLength = 0;
+};
+
+// Size caps on a request head; exceeding one is a 414 or 431
+struct HeadLimits
+{
+	size_t	requestLine = DEFAULT_MAX_REQUEST_LINE;
+	size_t	headerLine = DEFAULT_MAX_HEADER_LINE;
+	size_t	headerSize = DEFAULT_MAX_HEADER_SIZE;
+};
+
+// Resumable request head parser. Each feed() continues from where the last
+// one stopped, consuming complete lines only, so headers trickling in are
+// scanned once in total. Header names are matched case-insensitively and
+// only the ones the server acts on are recorded; nothing is allocated.
+// A malformed or oversized head stops the parser in FAILED with the
+// error kept for getError().
+class HttpRequestParser
+{
+	private:
+		ParseState	_state;
+		size_t		_lineStart;
+		size_t		_headEnd;
+
+		HttpMethod	_method;
+		Span		_target;
+		Span		_version;
+		Span		_host;
+		Span		_contentType;
+		Span		_transferEncoding;
+		Span		_connection;
+		Span		_expect;
+		size_t		_contentLength;
+		HeadLimits	_limits;
+		HttpError	_error;
+
+		HttpError	checkLimits(size_t lineLength, size_t headLength);
+		HttpError	parseRequestLine(std::string_view buffer, size_t lineEnd);
+		HttpError	parseHeaderLine(std::string_view buffer, size_t lineEnd);
+	public:
+		HttpRequestParser();
+
+		bool		feed(std::string_view buffer);
+		void		reset();
+		void		setLimits(const HeadLimits &limits);
+
+		RequestHead	getHead(std::string_view buffer) const;
+		size_t		getHeadEnd() const;
+		HttpError	getError() const;
+};
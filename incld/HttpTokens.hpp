@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Bit values so a location's allowed methods fit in one int
+enum class HttpMethod
+{
+	UNKNOWN = 0,
+	GET = 1,
+	POST = 2,
+	DELETE = 4,
+};
+
+// The request headers the server acts on; everything else is UNKNOWN
+enum class HeaderId
+{
+	UNKNOWN,
+	HOST,
+	CONTENT_TYPE,
+	CONTENT_LENGTH,
+	TRANSFER_ENCODING,
+	CONNECTION,
+	EXPECT,
+};
+
+namespace tokens
+{
+
+template <typename Id>
+struct Token
+{
+	std::string_view	name;
+	Id					id;
+};
+
+constexpr char	foldCase(char c)
+{
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+constexpr bool	equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (foldCase(a[i]) != foldCase(b[i]))
+			return false;
+	return true;
+}
+
+// FNV-1a over the case-folded bytes, so "Host" and "host" share a slot
+constexpr uint32_t	hashName(std::string_view name, uint32_t seed)
+{
+	uint32_t	hash = seed;
+
+	for (char c : name)
+		hash = (hash ^ static_cast<unsigned char>(foldCase(c))) * 16777619u;
+	return hash;
+}
+
+// Perfect hash over a fixed token set. The constructor searches for a seed
+// that sends every token to its own slot, which happens at compile time for
+// the constexpr tables below, so a lookup is one hash and one compare.
+template <typename Id, size_t N, size_t Slots>
+class PerfectHash
+{
+	static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+	static_assert(N < Slots, "Table needs a free slot");
+
+	private:
+		std::array<Token<Id>, N>	_tokens;
+		std::array<int, Slots>		_slots;
+		uint32_t					_seed;
+
+		// FNV's low bits only see the seed's low bits; fold the high half in
+		static constexpr size_t	slotOf(std::string_view name, uint32_t seed)
+		{
+			uint32_t	hash = hashName(name, seed);
+
+			return (hash ^ (hash >> 16)) & (Slots - 1);
+		}
+
+		constexpr bool	placeAll(uint32_t seed)
+		{
+			_slots.fill(-1);
+			for (size_t i = 0; i < N; ++i)
+			{
+				int	&slot = _slots[slotOf(_tokens[i].name, seed)];
+				if (slot != -1)
+					return false;
+				slot = static_cast<int>(i);
+			}
+			return true;
+		}
+	public:
+		constexpr PerfectHash(const std::array<Token<Id>, N> &tokens)
+			: _tokens{tokens}
+			, _slots{}
+			, _seed{2166136261u}
+		{
+			while (!placeAll(_seed))
+				++_seed;
+		}
+
+		// Case-insensitive when asked to be; the hash already folds case
+		constexpr Id	find(std::string_view name, bool ignoreCase, Id fallback) const
+		{
+			int	slot = _slots[slotOf(name, _seed)];
+
+			if (slot == -1)
+				return fallback;
+			const Token<Id>	&token = _tokens[slot];
+			bool			match = ignoreCase ? equalsIgnoreCase(token.name, name) : token.name == name;
+			return match ? token.id : fallback;
+		}
+};
+
+inline constexpr PerfectHash<HttpMethod, 3, 4>	g_methods({{
+	{"GET", HttpMethod::GET},
+	{"POST", HttpMethod::POST},
+	{"DELETE", HttpMethod::DELETE},
+}});
+
+inline constexpr PerfectHash<HeaderId, 6, 8>	g_headers({{
+	{"host", HeaderId::HOST},
+	{"content-type", HeaderId::CONTENT_TYPE},
+	{"content-length", HeaderId::CONTENT_LENGTH},
+	{"transfer-encoding", HeaderId::TRANSFER_ENCODING},
+	{"connection", HeaderId::CONNECTION},
+	{"expect", HeaderId::EXPECT},
+}});
+
+// Methods are case-sensitive (RFC 9110 9.1), header names are not (5.1)
+constexpr HttpMethod	lookupMethod(std::string_view name)
+{
+	return g_methods.find(name, false, HttpMethod::UNKNOWN);
+}
+
+constexpr HeaderId	lookupHeader(std::string_view name)
+{
+	return g_headers.find(name, true, HeaderId::UNKNOWN);
+}
+
+constexpr std::string_view	methodName(HttpMethod method)
+{
+	switch (method)
+	{
+		case HttpMethod::GET: return "GET";
+		case HttpMethod::POST: return "POST";
+		case HttpMethod::DELETE: return "DELETE";
+		default: return "";
+	}
+}
+
+static_assert(lookupMethod("DELETE") == HttpMethod::DELETE);
+static_assert(lookupMethod("get") == HttpMethod::UNKNOWN);
+static_assert(lookupHeader("Content-Length") == HeaderId::CONTENT_LENGTH);
+static_assert(lookupHeader("TRANSFER-ENCODING") == HeaderId::TRANSFER_ENCODING);
+static_assert(lookupHeader("Expect") == HeaderId::EXPECT);
+static_assert(lookupHeader("X-Host") == HeaderId::UNKNOWN);
+
+}
@@ -2,8 +2,13 @@
 
 #include <sys/epoll.h>
 
+#include "IEventBackend.hpp"
+
+// Completions only reach owners of fds registered with EVENT_* interest
+// or sent on, so the other owners keep the default
 struct IEpollFdOwner
 {
 	virtual void handleEpollEvent(epoll_event &ev, int eventFd) = 0;
+	virtual void handleCompletion(Completion &completion, int eventFd) { (void)completion; (void)eventFd; }
 	virtual ~IEpollFdOwner() {};
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <sys/epoll.h>
+#include <sys/types.h>
+
+// Interest bits past the EPOLL* ones, for completion-based backends: they
+// serve EPOLLIN on such an fd with a multishot accept, or a multishot recv
+// into provided buffers, and report the results as Completions instead of
+// readiness. Readiness backends drop them and report EPOLLIN as usual.
+#define EVENT_ACCEPT (1u << 24)
+#define EVENT_RECV (1u << 25)
+#define EVENT_COMPLETION_MASK (EVENT_ACCEPT | EVENT_RECV)
+
+enum class CompletionOp : uint8_t
+{
+	ACCEPT,
+	RECV,
+	SEND,
+};
+
+// An operation a completion-based backend carried out for an fd. result is
+// what the matching syscall returns: the accepted fd or a byte count, with
+// -errno for a failure. Received bytes sit in a provided buffer that stays
+// valid until the next wait.
+struct Completion
+{
+	CompletionOp	op;
+	int				result;
+	const char		*data;
+	uint64_t		token;
+};
+
+// A file range to send right behind the bytes handed to send()
+struct FileChunk
+{
+	int		fd;
+	size_t	length;
+	off_t	offset;
+};
+
+// Readiness multiplexer owned by a Worker. Interest masks use the EPOLL*
+// bits, and ready fds are reported as epoll_event so IEpollFdOwner handlers
+// work unchanged whichever backend is selected. The token is returned as-is
+// in epoll_event.data.u64. Modifications may be queued until flush(), which
+// wait() does on its own.
+// A completion-based backend also performs I/O itself: send() and the
+// EVENT_* interest bits, their results collected by wait() into
+// getCompletions() and tagged with the fd's token. send() may take only
+// part of what it is given, data first; its completion says how much
+// went out. One send at a time per fd.
+struct IEventBackend
+{
+	virtual void	add(int fd, uint32_t events, uint64_t token) = 0;
+	virtual void	modify(int fd, uint32_t events, uint64_t token) = 0;
+	virtual void	remove(int fd) = 0;
+	virtual void	release(int fd) = 0;
+	virtual void	flush() = 0;
+	virtual int		wait(std::vector<epoll_event> &events, int timeoutMs) = 0;
+
+	virtual bool	isCompletionBased() = 0;
+	virtual void	send(int fd, const char *data, size_t length, const FileChunk *chunk) = 0;
+	virtual std::vector<Completion>	&getCompletions() = 0;
+	virtual ~IEventBackend() {};
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "TimerWheel.hpp"
+
+// Intrusive LRU of keep-alive connections waiting for their next request,
+// oldest at the front. There is one per listener, so eviction can target
+// the listener whose limit was hit. Reuses TimerNode as the link so a Client carries the
+// node inline and joining or leaving the list never allocates.
+class IdleList
+{
+	private:
+		TimerNode	_head;
+		size_t		_size;
+	public:
+		IdleList()
+			: _size{0}
+		{
+			_head.prev = &_head;
+			_head.next = &_head;
+		}
+
+		IdleList(const IdleList&) = delete;
+		IdleList& operator=(const IdleList&) = delete;
+
+		void	remove(TimerNode &node)
+		{
+			if (!node.isLinked())
+				return;
+			node.prev->next = node.next;
+			node.next->prev = node.prev;
+			node.prev = nullptr;
+			node.next = nullptr;
+			--_size;
+		}
+
+		void	pushBack(TimerNode &node)
+		{
+			remove(node);
+			node.prev = _head.prev;
+			node.next = &_head;
+			_head.prev->next = &node;
+			_head.prev = &node;
+			++_size;
+		}
+
+		const TimerNode	*front() const
+		{
+			return _size ? _head.next : nullptr;
+		}
+
+		int	oldest() const
+		{
+			return _size ? _head.next->key : -1;
+		}
+
+		size_t	size() const
+		{
+			return _size;
+		}
+};
@@ -8,56 +8,83 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 
 #include "webserv.hpp"
 #include "Program.hpp"
+#include "Worker.hpp"
 #include "HttpException.hpp"
 #include "IEpollFdOwner.hpp"
 #include "utils.hpp"
 #include "Client.hpp"
-
-#define QUEUE_SIZE 20
+#include "ConnectionStats.hpp"
+#include "IdleList.hpp"
 
 class IpPort : public IEpollFdOwner
 {
 	private:
-		FdClientMap		&_clientsMap;
-		FdEpollOwnerMap	&_handlersMap;
+		Worker			&_worker;
+		FdClientTable		&_clientsTable;
+		FdEpollOwnerTable	&_handlersTable;
 
 		ServerDeq		_servers;
 		std::string		_addrPort;
+		ListenConfig	_listenConfig;
 
 		int				_sockFd;
-		int				&_epollFd;
+		ConnectionStatsPtr	_stats;
+		IdleList		_idleList;
+		bool			_paused;
 
 		void		parseRequest(ClientPtr &client);
-		void		parseHeaders(ClientPtr &client);
-		void		parseQuery(ClientPtr &client, const std::string &pathAndQuery);
+		bool		parseHeaders(ClientPtr &client, HttpError &error);
+		HttpError	parseQuery(ClientPtr &client, std::string_view pathAndQuery);
+		void		rejectRequest(ClientPtr &client, const HttpError &error);
+		void		sendContinue(ClientPtr &client);
 		void		assignServerToClient(ClientPtr &client);
+		void		shedRequest(ClientPtr &client);
 
-		void		handleGetRequest(ClientPtr &client);
-		void		handleDeleteRequest(ClientPtr &client);
+		HttpError	handleGetRequest(ClientPtr &client);
+		HttpError	handleDeleteRequest(ClientPtr &client);
 		bool		listDirectory(ClientPtr &client, std::string &listingBuffer);
 		std::string	formHeaders(ClientPtr &client, std::string &filePath, size_t contentLength, int code);
 		std::string	getErrorPagePath(ClientPtr &client, int statusCode);
+		int			getConnectionLimit();
+		bool		reserveSlot();
+		void		releaseSlot();
+		IpPort		*findEvictionSource();
+		bool		evictIdleConnection();
 	public:
 		~IpPort();
-		IpPort(Program &program);
+		IpPort(Worker &worker);
 
-		void			OpenSocket(addrinfo &hints, addrinfo **_servInfo);
+		void			OpenSocket(addrinfo &hints, addrinfo **_servInfo, bool inheritedOnly);
+		void			closeSocket();
+		void			applyListenOptions();
 		void			handleEpollEvent(epoll_event &ev, int eventFd);
+		void			handleCompletion(Completion &completion, int eventFd);
 		void			acceptConnection();
+		void			registerConnection(int clientFd);
 		void			closeConnection(int &clientFd);
+		void			processRequests(ClientPtr &client);
+		void			closeOnceFlushed(ClientPtr &client);
+		bool			hasCapacity();
+		bool			canEvictIdle();
 		std::string		getStatusText(int statusCode);
 		void			generateResponse(ClientPtr &client, std::string path, int statusCode);
 
 		int					getSockFd();
-		FdClientMap&		getClientsMap();
-		FdEpollOwnerMap&	getHandlersMap();
+		Worker&				getWorker();
+		FdClientTable&		getClientsTable();
+		FdEpollOwnerTable&	getHandlersTable();
 		ServerDeq&			getServers();
 		const std::string&	getAddrPort();
-		int&				getEpollFd();
+		ConnectionStats&	getStats();
+		IdleList&			getIdleList();
+		bool				isPaused();
 
 		void				setSockFd(int fd);
 		void				setAddrPort(const std::string& addrPort);
+		void				setListenConfig(const ListenConfig& listenConfig);
+		void				setPaused(bool paused);
 };
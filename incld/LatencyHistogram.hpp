@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+#define LATENCY_BUCKETS 24
+
+// Log2 histogram of durations in microseconds: bucket i counts samples
+// below 2^i us, the last one everything from ~4 s up. Written by its worker
+// only; the relaxed atomics let another thread read it for a report.
+class LatencyHistogram
+{
+	private:
+		std::atomic<uint64_t>	_buckets[LATENCY_BUCKETS] = {};
+		std::atomic<uint64_t>	_count{0};
+		std::atomic<uint64_t>	_max{0};
+
+		static int	bucketOf(uint64_t micros)
+		{
+			int	bucket = 0;
+
+			while (bucket < LATENCY_BUCKETS - 1 && micros >= (1ULL << bucket))
+				++bucket;
+			return bucket;
+		}
+	public:
+		void	record(std::chrono::steady_clock::duration elapsed)
+		{
+			auto		us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+			uint64_t	micros = us > 0 ? static_cast<uint64_t>(us) : 0;
+
+			_buckets[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+			_count.fetch_add(1, std::memory_order_relaxed);
+			if (micros > _max.load(std::memory_order_relaxed))
+				_max.store(micros, std::memory_order_relaxed);
+		}
+
+		// Upper bound, in microseconds, of the bucket holding the given quantile
+		uint64_t	percentile(double quantile) const
+		{
+			uint64_t	count = _count.load(std::memory_order_relaxed);
+			uint64_t	target = static_cast<uint64_t>(count * quantile);
+			uint64_t	seen = 0;
+
+			for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+			{
+				seen += _buckets[bucket].load(std::memory_order_relaxed);
+				if (seen > target)
+					return 1ULL << bucket;
+			}
+			return _max.load(std::memory_order_relaxed);
+		}
+
+		// "count N p50 X p99 Y max Z us | <2us:N <4us:N ..." for the logs
+		std::string	summary() const
+		{
+			std::string	out = "count " + std::to_string(_count.load(std::memory_order_relaxed))
+				+ " p50 " + std::to_string(percentile(0.5))
+				+ " p99 " + std::to_string(percentile(0.99))
+				+ " max " + std::to_string(_max.load(std::memory_order_relaxed)) + " us |";
+
+			for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+			{
+				uint64_t	samples = _buckets[bucket].load(std::memory_order_relaxed);
+				if (!samples)
+					continue;
+				if (bucket == LATENCY_BUCKETS - 1)
+					out += " >=" + std::to_string(1ULL << (bucket - 1)) + "us:" + std::to_string(samples);
+				else
+					out += " <" + std::to_string(1ULL << bucket) + "us:" + std::to_string(samples);
+			}
+			return out;
+		}
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
+
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+// Levels below this are compiled out, e.g. make LOG_COMPILE_LEVEL=1
+#ifndef LOG_COMPILE_LEVEL
+# define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_RING_SIZE 4096
+#define LOG_RECORD_SIZE 256
+#define LOG_FLUSH_INTERVAL_MS 10
+#define LOG_BATCH_SIZE (64 * 1024)
+
+// Arguments are only evaluated when the level is enabled
+#define LOG_AT(level, ...) \
+	do { \
+		if constexpr ((level) >= LOG_COMPILE_LEVEL) \
+			if (Logger::isEnabled(level)) \
+				Logger::log(level, __VA_ARGS__); \
+	} while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+struct LogSlot
+{
+	std::atomic<size_t>	sequence;
+	int					level;
+	size_t				length;
+	char				text[LOG_RECORD_SIZE];
+};
+
+// Process-wide asynchronous logger. Event loop threads format a record
+// straight into a slot of a bounded lock-free ring (Vyukov MPMC queue) and
+// move on; a background thread drains the ring and writes whole batches
+// with one write(2) per stream. When the ring is full records are dropped
+// and counted rather than blocking the loop.
+class Logger
+{
+	private:
+		static LogSlot				_slots[LOG_RING_SIZE];
+		static std::atomic<size_t>	_enqueuePos;
+		static size_t				_dequeuePos;
+		static std::atomic<int>		_level;
+		static std::atomic<size_t>	_dropped;
+		static std::atomic<bool>	_running;
+		static std::thread			*_flusher;
+		static pid_t				_ownerPid;
+
+		static LogSlot	*claim(size_t &pos);
+		static void		publish(LogSlot *slot, size_t pos);
+		static size_t	drain();
+		static void		flusherLoop();
+
+		static void	append(LogSlot &slot, std::string_view text);
+
+		template <typename T>
+		requires std::is_arithmetic_v<T>
+		static void	append(LogSlot &slot, T value)
+		{
+			if constexpr (std::is_same_v<T, bool>)
+				append(slot, value ? "true" : "false");
+			else if constexpr (std::is_same_v<T, char>)
+				append(slot, std::string_view(&value, 1));
+			else
+			{
+				auto	res = std::to_chars(slot.text + slot.length, slot.text + LOG_RECORD_SIZE, value);
+				if (res.ec == std::errc())
+					slot.length = res.ptr - slot.text;
+			}
+		}
+	public:
+		static void	start();
+		static void	stop();
+
+		static void	setLevel(int level);
+		static int	parseLevel(const std::string &name);
+
+		static bool	isEnabled(int level)
+		{
+			return level >= _level.load(std::memory_order_relaxed);
+		}
+
+		template <typename... Args>
+		static void	log(int level, const Args&... args)
+		{
+			size_t	pos;
+			LogSlot	*slot = claim(pos);
+
+			if (!slot)
+				return;
+			slot->level = level;
+			slot->length = 0;
+			(append(*slot, args), ...);
+			publish(slot, pos);
+		}
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bytes held in connection read buffers across every worker. Each client
+// charges its growth before keeping it and gives it all back on close, so
+// a handful of hostile peers can't push the process into swap.
+struct MemoryBudget
+{
+	std::atomic<size_t>		used{0};
+	std::atomic<size_t>		peak{0};
+	std::atomic<uint64_t>	refused{0};
+
+	// A limit of 0 means unlimited
+	bool	tryCharge(size_t bytes, size_t limit)
+	{
+		size_t	current = used.load(std::memory_order_relaxed);
+
+		do
+		{
+			if (limit > 0 && current + bytes > limit)
+			{
+				refused.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+		while (!used.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+		if (current + bytes > peak.load(std::memory_order_relaxed))
+			peak.store(current + bytes, std::memory_order_relaxed);
+		return true;
+	}
+
+	size_t	available(size_t limit) const
+	{
+		size_t	current = used.load(std::memory_order_relaxed);
+
+		return current < limit ? limit - current : 0;
+	}
+
+	void	release(size_t bytes)
+	{
+		used.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+};
@@ -5,7 +5,6 @@
 #include <fstream>
 
 #include "webserv.hpp"
-#include "ChildFailedException.hpp"
 
 enum class BodyReadStatus
 {
@@ -15,12 +14,12 @@ enum class BodyReadStatus
 };
 
 #define MAX_CHUNK_SIZE 1010241024
+#define UPLOAD_FLUSH_SIZE (64 * 1024)
+#define UPLOAD_PARTIAL_SUFFIX ".part"
 
 class PostRequestHandler
 {
 	private:
-		IpPort			&_ipPort;
-
 		std::string		_uploadFilename;
 		std::string		_bodyBuffer;
 		std::string		_decodedBuffer;
@@ -34,6 +33,7 @@ class PostRequestHandler
 		bool			_readingChunkSize;
 		bool			_parsingChunkTrailers;
 		bool			_chunkedFinished;
+		bool			_multipartFinished;
 
 		BodyReadStatus	getContentLengthBody(ClientPtr &client);
 		BodyReadStatus	getChunkedBody(ClientPtr &client);
@@ -42,12 +42,16 @@ class PostRequestHandler
 
 		bool			extractFilename(std::string &dashBoundary);
 		std::string		composeUploadPath(ClientPtr &client);
+		void			flushUpload(ClientPtr &client);
 		void			writeBodyPart(ClientPtr &client);
 		void			getLastBoundary(std::string &boundaryMarker);
 		void			processPostCgi(ClientPtr &client, BodyReadStatus status);
 	public:
-		PostRequestHandler(IpPort &owner);
+		PostRequestHandler();
 		~PostRequestHandler();
 		void			handlePostRequest(ClientPtr &client);
 		void			resetBodyState();
+
+		size_t			getBufferedSize();
+		size_t			getBufferCapacity();
 };
@@ -1,45 +1,77 @@
 #pragma once
 
 #include <chrono>
+#include <atomic>
+#include <csignal>
+
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <climits>
+#include <cstdlib>
+#include <mutex>
 
 #include "webserv.hpp"
 #include "ConfigParser.hpp"
 #include "CustomException.hpp"
-#include "ChildFailedException.hpp"
+#include "IEpollFdOwner.hpp"
 #include "Client.hpp"
+#include "ConnectionStats.hpp"
+#include "MemoryBudget.hpp"
 
 #define DEFAULT_CONF "conf/default.conf"
-#define MAX_EVENTS 10
-#define DEFAULT_EPOLL_SIZE 10
-#define TIMEOUT_SECONDS 360
+#define LISTEN_FDS_START 3
+#define UPGRADE_PARENT_ENV "WEBSERV_PARENT_PID"
 
-class Program
+// A listening socket handed over by the previous binary (or by systemd)
+struct InheritedSocket
 {
-	private:
-		int						_epollFd;
-		IpPortDeq	_addrPortVec;
-		addrinfo				*_servInfo;
-
-		ServerDeq				_servers;
+	int					fd;
+	sockaddr_storage	addr;
+	socklen_t			addrLen;
+};
 
-		epoll_event				_ev;
-		epoll_event				_events[MAX_EVENTS];
+class Program : public IEpollFdOwner
+{
+	private:
+		std::string						_confPath;
+		std::string						_exePath;
+		std::vector<std::string>		_args;
+		std::vector<InheritedSocket>	_inheritedSockets;
+		GlobalConfig					_globalConfig;
+		std::atomic<ConfigSnapshotPtr>	_snapshot;
+		WorkerDeq						_workers;
+		int								_signalFd;
+		pid_t							_upgradePid;
+		ConnectionStats					_connectionStats;
+		MemoryBudget					_bufferMemory;
+		std::map<std::string, ConnectionStatsPtr>	_listenerStats;
+		std::mutex						_listenerStatsMutex;
 
-		FdClientMap				_clientsMap;
-		FdEpollOwnerMap			_handlersMap;
-		Time					_nextTimeoutCheck;
+		ConfigSnapshotPtr	loadConfig(GlobalConfig &globalConfig, uint64_t generation);
+		void				initSignals();
+		void				reloadConfig();
+		void				collectInheritedSockets();
+		void				closeUnclaimedSockets();
+		void				spawnUpgrade();
+		void				reapUpgrade();
+		void				drainWorkers();
+		void				reportStats();
 	public:
 		Program();
 		~Program();
 
+		void	setCommandLine(char **av);
 		void	parseConfFile(char *conf_file);
+		int		takeInheritedSocket(const sockaddr *addr, socklen_t addrLen);
 		void	initSockets();
-		void	waitEpollEvent();
-		void	checkTimeOut();
-
-		int				&getEpollFd();
-		FdClientMap		&getClientsMap();
-		FdEpollOwnerMap	&getHandlersMap();
-		IpPortDeq		&getAddrPortVec();
-		ServerDeq 		&getServers();
+		void	runWorkers();
+		void	handleEpollEvent(epoll_event &ev, int eventFd);
+
+		GlobalConfig		&getGlobalConfig();
+		ConnectionStats		&getConnectionStats();
+		MemoryBudget		&getBufferMemory();
+		ConnectionStatsPtr	getListenerStats(const std::string &addrPort);
+		ConfigSnapshotPtr	getSnapshot();
+		WorkerDeq			&getWorkers();
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <cstddef>
+
+#include <sys/types.h>
+
+#define READ_BUFFER_MIN_HINT 4096
+#define READ_BUFFER_MAX_HINT (256 * 1024)
+#define READ_BUFFER_SPILL_SIZE (64 * 1024)
+
+// Connection input buffer. Consuming moves the read offset instead of
+// shifting the bytes behind it; the unread tail is only moved to the front
+// when a read needs the room. Each read is a readv into the free space plus
+// a stack spill segment, so one call takes whatever the socket holds up to
+// the caller's limit, and the space kept free follows recent read sizes.
+// Bytes a completion-based backend received elsewhere are appended instead.
+class ReadBuffer
+{
+	private:
+		std::unique_ptr<char[]>	_storage;
+		size_t					_capacity;
+		size_t					_head;
+		size_t					_tail;
+		size_t					_readHint;
+
+		void	reserve(size_t freeSpace);
+	public:
+		ReadBuffer();
+
+		ReadBuffer(const ReadBuffer&) = delete;
+		ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+		ssize_t	readFrom(int fd, size_t maxBytes);
+		void	append(const char *data, size_t length);
+		void	consume(size_t length);
+		void	clear();
+		void	release(size_t keepCapacity);
+
+		const char			*data() const { return _storage.get() + _head; }
+		size_t				size() const { return _tail - _head; }
+		bool				empty() const { return _tail == _head; }
+		size_t				capacity() const { return _capacity; }
+		std::string_view	view() const { return std::string_view(data(), size()); }
+		char				operator[](size_t index) const { return data()[index]; }
+};
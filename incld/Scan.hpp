@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte scanning kernels for the HTTP parsers. AVX2 and SSE4.2 versions
+// are picked once at startup from what the CPU supports, with a scalar
+// fallback; all of them give the same results.
+namespace scan
+{
+
+// Offset of the first "\r\n", or size if there is none
+size_t		findCrlf(const char *data, size_t size);
+
+// Offset of the first "\r\n\r\n", or size if there is none
+size_t		findDoubleCrlf(const char *data, size_t size);
+
+// Length of the leading run of RFC 9110 token characters
+size_t		tokenLength(const char *data, size_t size);
+
+// Parses the leading hex digits into value. Returns how many there were,
+// or 0 when there are none or more than fit in 64 bits.
+size_t		parseHex(const char *data, size_t size, uint64_t &value);
+
+// Length of the leading part of a request path that canonicalization
+// leaves as it is: no '%', no control bytes, no "//" and no "/."
+size_t		pathCleanLength(const char *data, size_t size);
+
+const char	*implementation();
+
+// Names of the kernel sets this CPU can run, the default one first
+std::vector<const char*>	implementations();
+
+// Switches every scan function to the named kernel set, so tests can hold
+// them against each other. Not thread-safe: only before workers start.
+// Returns false when the CPU can't run it.
+bool		useImplementation(const char *name);
+
+}
@@ -27,6 +27,8 @@ class Server
 		std::string							_port;
 
 		size_t								_clientBodySize;
+		int									_maxConnections;
+		bool								_tcpNopush;
 		std::map<int, std::string>			_errorPages;
 		std::vector<Location>				_locations;
 
@@ -39,8 +41,9 @@ class Server
 		Server(const ServerConfig& config);
 		~Server();
 
-		bool								areHeadersValid(ClientPtr &client);
-		std::string							findFile(ClientPtr &client, const std::string& path, const Location* matchedLocation);
+		HttpError							validateRequest(ClientPtr &client);
+		HttpError							findFile(ClientPtr &client, const std::string& path,
+												const Location* matchedLocation, std::string &resolved);
 		std::string							getCustomErrorPage(int statusCode);
 
 		void								setHost(std::string host);
@@ -54,6 +57,8 @@ class Server
 		std::string&						getPort();
 		const std::string&					getServerName();
 		size_t								getClientBodySize();
+		int									getMaxConnections();
+		bool								isTcpNopush();
 		const std::map<int, std::string>&	getErrorPages();
 		const std::vector<Location>&		getLocations();
 };
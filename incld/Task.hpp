@@ -0,0 +1,84 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#define FRAME_POOL_GRANULE 256
+#define FRAME_POOL_CLASSES 16
+#define FRAME_POOL_MAX_FREE 256
+
+// Per-thread free lists of coroutine frames, one per 256-byte size class
+// up to 4 KiB. A worker starts and ends its frames on its own thread, so
+// a steady request rate settles into reusing the same few blocks.
+class FramePool
+{
+	private:
+		std::vector<void*>	_free[FRAME_POOL_CLASSES];
+	public:
+		FramePool() = default;
+		~FramePool();
+
+		FramePool(const FramePool&) = delete;
+		FramePool& operator=(const FramePool&) = delete;
+
+		static FramePool	&local();
+
+		void	*allocate(size_t size);
+		void	deallocate(void *frame, size_t size);
+};
+
+// Lazily started coroutine owned by the object whose events drive it.
+// It only runs inside resume(), so the owner always knows when its frame
+// may touch it; destroying a suspended Task simply drops the frame.
+class Task
+{
+	public:
+		struct promise_type
+		{
+			std::exception_ptr	exception;
+
+			Task				get_return_object() { return Task(Handle::from_promise(*this)); }
+			std::suspend_always	initial_suspend() noexcept { return {}; }
+			std::suspend_always	final_suspend() noexcept { return {}; }
+			void				return_void() {}
+			void				unhandled_exception() { exception = std::current_exception(); }
+
+			static void	*operator new(size_t size) { return FramePool::local().allocate(size); }
+			static void	operator delete(void *frame, size_t size) { FramePool::local().deallocate(frame, size); }
+		};
+		using Handle = std::coroutine_handle<promise_type>;
+	private:
+		Handle	_handle;
+
+		void	destroy();
+	public:
+		Task();
+		explicit Task(Handle handle);
+		Task(Task &&other) noexcept;
+		Task& operator=(Task &&other) noexcept;
+		~Task();
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		bool	resume();
+
+		explicit operator bool() const { return static_cast<bool>(_handle); }
+};
+
+// Readiness of one fd as an awaitable. The owner keeps routing the fd's
+// events to itself, stores them here and resumes the Task waiting on it;
+// interest is still managed by the owner's state. An operation a
+// completion-based backend finished leaves its result here instead.
+struct FdEvent
+{
+	uint32_t	events = 0;
+	int			result = 0;
+
+	bool		await_ready() const noexcept { return false; }
+	void		await_suspend(std::coroutine_handle<>) const noexcept {}
+	uint32_t	await_resume() const noexcept { return events; }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "webserv.hpp"
+#include "LatencyHistogram.hpp"
+
+#define TIMER_TICK_MS 100
+#define TIMER_LEVEL0_BITS 8
+#define TIMER_LEVELN_BITS 6
+#define TIMER_LEVELS 4
+
+#define TIMER_LEVEL0_SIZE (1 << TIMER_LEVEL0_BITS)
+#define TIMER_LEVELN_SIZE (1 << TIMER_LEVELN_BITS)
+#define TIMER_MAX_TICKS ((1ULL << (TIMER_LEVEL0_BITS + (TIMER_LEVELS - 1) * TIMER_LEVELN_BITS)) - 1)
+
+struct TimerNode
+{
+	TimerNode	*prev = nullptr;
+	TimerNode	*next = nullptr;
+	uint64_t	expiry = 0;
+	int			key = -1;
+
+	bool	isLinked() const { return prev != nullptr; }
+};
+
+// Hierarchical timing wheel: level 0 has one slot per tick, every upper level
+// covers a whole revolution of the level below and is cascaded down when that
+// level wraps. Scheduling and cancelling are O(1), expiry is O(expired).
+class TimerWheel
+{
+	private:
+		Time		_start;
+		uint64_t	_currentTick;
+		size_t		_count;
+		LatencyHistogram	_lateness;
+
+		TimerNode	_level0[TIMER_LEVEL0_SIZE];
+		TimerNode	_levels[TIMER_LEVELS - 1][TIMER_LEVELN_SIZE];
+
+		uint64_t	toTick(Time t);
+		void		link(TimerNode &node);
+		void		unlink(TimerNode &node);
+		void		cascade(int level);
+		void		initSlot(TimerNode &head);
+
+	public:
+		TimerWheel(Time now);
+		~TimerWheel();
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		void	schedule(TimerNode &node, Time deadline);
+		void	cancel(TimerNode &node);
+		void	advance(Time now, std::vector<int> &expired);
+		int		getNextTimeoutMs(Time now);
+
+		size_t	size();
+		const LatencyHistogram	&getLateness();
+};
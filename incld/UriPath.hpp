@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "HttpException.hpp"
+
+// Canonical form of the path part of a request target, built once per
+// request and shared by routing, file lookup and anything keyed on the
+// URL: percent-escapes decoded, "//" collapsed, "." and ".." resolved
+// (RFC 3986 5.2.4). Malformed escapes, control bytes, an encoded '/' and
+// any ".." that climbs above the root are a 400.
+namespace uri
+{
+
+HttpError	normalizePath(std::string_view raw, std::string &out);
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "webserv.hpp"
+#include "IEventBackend.hpp"
+#include "CustomException.hpp"
+
+#define URING_MIN_ENTRIES 1024
+#define URING_IGNORE_CQE UINT64_MAX
+// user_data is op << 56 | serial << 32 | fd, the serial cut to 24 bits
+#define URING_SERIAL_MASK 0xffffffu
+// Provided buffers multishot recvs pick from, as a power of two
+#define URING_RECV_BUFFERS 256
+#define URING_RECV_BUFFER_SIZE (16 * 1024)
+#define URING_BUFFER_GROUP 0
+// What one send carries at most, and how many idle send buffers keep theirs
+#define URING_SEND_BUFFER_SIZE (64 * 1024)
+#define URING_SEND_BUFFERS_KEPT 64
+
+enum class UringOp : uint8_t
+{
+	POLL,
+	ACCEPT,
+	RECV,
+	SEND,
+};
+
+// generation counts poll arms. serial numbers the fd's registrations,
+// multishot operations and sends together, so a completion can be told
+// apart as belonging to the current registration or an earlier one.
+struct UringFdState
+{
+	uint32_t	events = 0;
+	uint64_t	token = 0;
+	uint32_t	generation = 0;
+	uint32_t	serial = 0;
+	uint32_t	registration = 0;
+	uint32_t	streamSerial = 0;
+	uint32_t	sendBuffer = 0;
+	bool		armed = false;
+	bool		streaming = false;
+	bool		sending = false;
+};
+
+struct UringSendBuffer
+{
+	std::unique_ptr<char[]>	data;
+	uint32_t				serial = 0;
+};
+
+// io_uring backend, completion-based for sockets. A listener registered
+// with EVENT_ACCEPT gets a multishot accept and a client socket with
+// EVENT_RECV a multishot recv into a ring of provided buffers; send() copies
+// what it is given into a buffer of its own, a file chunk read in behind it
+// by a linked READ. Whatever the kernel reads or writes is owned here and
+// only reused once its completion is in, so a connection can close with
+// operations still in flight. Everything else, CGI pipes and EPOLLOUT
+// included, is watched with POLL_ADD: level-triggered interest uses one-shot
+// polls re-armed before the next wait, EPOLLET maps to multishot polls.
+// Changes are only submitted together with the next wait, so a whole loop
+// iteration costs a single io_uring_enter.
+class UringBackend : public IEventBackend
+{
+	private:
+		int							_ringFd;
+		io_uring_params				_params;
+
+		void						*_ringPtr;
+		size_t						_ringSize;
+		io_uring_sqe				*_sqes;
+		size_t						_sqesSize;
+
+		unsigned					*_sqHead;
+		unsigned					*_sqTail;
+		unsigned					*_sqMask;
+		unsigned					*_sqArray;
+		unsigned					*_cqHead;
+		unsigned					*_cqTail;
+		unsigned					*_cqMask;
+		io_uring_cqe				*_cqes;
+
+		io_uring_buf_ring			*_bufferRing;
+		char						*_recvBuffers;
+		uint16_t					_bufferTail;
+		std::vector<uint16_t>		_usedBuffers;
+
+		std::vector<UringSendBuffer>	_sendBuffers;
+		std::vector<uint32_t>			_freeSendBuffers;
+
+		unsigned					_sqTailLocal;
+		std::vector<UringFdState>	_fdStates;
+		std::vector<int>			_rearm;
+		std::vector<Completion>		_completions;
+
+		void			mapRings(unsigned entries);
+		void			setupBufferRing();
+		void			teardown();
+		void			reserveSqes(unsigned count);
+		io_uring_sqe	*getSqe();
+		int				enter(unsigned minComplete, int timeoutMs);
+		void			arm(int fd);
+		void			disarm(int fd);
+		void			startStream(int fd);
+		void			stopStream(int fd);
+		void			cancel(uint64_t userData);
+		void			update(int fd);
+		void			provideBuffer(uint16_t bid);
+		void			recycleBuffers();
+		uint32_t		acquireSendBuffer();
+		void			releaseSendBuffer(uint32_t index);
+		UringFdState	&getFdState(int fd);
+		bool			harvestPoll(int fd, uint32_t generation, int res, uint32_t flags, epoll_event &event);
+		void			harvestCompletion(UringOp op, int fd, uint32_t serial, int res, uint32_t flags);
+		int				harvest(std::vector<epoll_event> &events);
+	public:
+		UringBackend(unsigned entries);
+		~UringBackend();
+
+		UringBackend(const UringBackend&) = delete;
+		UringBackend& operator=(const UringBackend&) = delete;
+
+		void	add(int fd, uint32_t events, uint64_t token);
+		void	modify(int fd, uint32_t events, uint64_t token);
+		void	remove(int fd);
+		void	release(int fd);
+		void	flush();
+		int		wait(std::vector<epoll_event> &events, int timeoutMs);
+
+		bool	isCompletionBased();
+		void	send(int fd, const char *data, size_t length, const FileChunk *chunk);
+		std::vector<Completion>	&getCompletions();
+};
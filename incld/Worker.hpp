@@ -0,0 +1,117 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+#include "webserv.hpp"
+#include "CustomException.hpp"
+#include "Client.hpp"
+#include "TimerWheel.hpp"
+#include "LatencyHistogram.hpp"
+#include "HttpRequestParser.hpp"
+#include "ClientPool.hpp"
+#include "IEpollFdOwner.hpp"
+#include "IEventBackend.hpp"
+#include "EpollBackend.hpp"
+#include "UringBackend.hpp"
+
+// How often a worker with a paused listener rechecks the limits, since
+// slots freed by other workers don't wake it
+#define ADMISSION_RETRY_MS 100
+// Weight of the newest batch in the smoothed loop lag, as 1 / 2^n
+#define LOOP_LAG_SMOOTHING_SHIFT 3
+
+class Worker : public IEpollFdOwner
+{
+	private:
+		Program					&_program;
+		int						_id;
+		EventBackendPtr			_eventBackend;
+		IpPortDeq				_addrPortVec;
+		std::mutex				_listenersMutex;
+		addrinfo				*_servInfo;
+		int						_wakeFd;
+		uint64_t				_configGeneration;
+		std::atomic<bool>		_drainRequested;
+		bool					_draining;
+
+		std::vector<epoll_event>	_events;
+
+		TimerWheel				_timerWheel;
+		std::vector<int>		_expiredTimers;
+		int						_pausedListeners;
+		ClientPool				_clientPool;
+		FdClientTable				_clientsTable;
+		FdEpollOwnerTable			_handlersTable;
+		std::vector<ClientPtr>		_closingClients;
+		uint32_t				_edgeTriggerFlag;
+		uint32_t				_socketEventFlags;
+
+		LatencyHistogram		_loopLag;
+		uint64_t				_smoothedLagUs;
+		bool					_overloaded;
+		Time					_lastBatchEnd;
+		std::string				_overloadResponse;
+		HeadLimits				_headLimits;
+
+		std::thread				_thread;
+
+		void	run();
+		void	pinToCpu();
+		void	createEventBackend();
+		bool	openListener(IpPort &ipPort, bool inheritedOnly);
+		void	reopenListener(IpPort &ipPort);
+		void	closeListener(IpPort &ipPort);
+		void	updateListenOptions(IpPort &ipPort);
+		void	applySnapshot(const ConfigSnapshotPtr &snapshot);
+		void	startDrain();
+		void	resumeListeners();
+		void	wake();
+		void	reapClosedClients();
+		void	dispatchCompletions();
+		void	recordLoopLag(Time batchEnd);
+		void	checkIdleRecovery();
+	public:
+		Worker(Program &program, int id);
+		~Worker();
+
+		void	initSockets();
+		bool	adoptInheritedListener();
+		void	collectListenFds(std::vector<int> &fds);
+		void	waitEpollEvent();
+		void	handleTimeouts();
+		void	start();
+		void	join();
+		void	watchFd(int fd, uint32_t events, IEpollFdOwner *owner);
+		void	notifyReload();
+		void	requestDrain();
+		void	pauseListener(IpPort &ipPort);
+		IpPort	*findOldestIdleListener();
+		void	deferClose(ClientPtr client);
+		void	handleEpollEvent(epoll_event &ev, int eventFd);
+
+		int				getId();
+		Program			&getProgram();
+		bool			isDraining();
+		bool			isOverloaded();
+		const std::string	&getOverloadResponse();
+		const HeadLimits	&getHeadLimits();
+		const LatencyHistogram	&getLoopLag();
+		uint32_t		getEdgeTriggerFlag();
+		bool			isEdgeTriggered();
+		uint32_t		getSocketEventFlags();
+		bool			isCompletionBased();
+		int				getAcceptBudget();
+		IEventBackend	&getEventBackend();
+		TimerWheel		&getTimerWheel();
+		ClientPool		&getClientPool();
+		std::chrono::seconds	getPhaseTimeout(TimerPhase phase);
+		FdClientTable		&getClientsTable();
+		FdEpollOwnerTable	&getHandlersTable();
+		IpPortDeq		&getAddrPortVec();
+};
@@ -27,12 +27,9 @@ inline void	makeFdNoninheritable(int fd)
 		THROW_ERRNO("fcntl(F_SETFD)");
 }
 
-inline void	changeEpollHandler(FdEpollOwnerMap &map, int fd, IEpollFdOwner *newHandler)
+inline void	changeEpollHandler(FdEpollOwnerTable &map, int fd, IEpollFdOwner *newHandler)
 {
-	auto elem = map.find(fd);
-	if (elem == map.end())
-		THROW("Uknown fd in FdEpollOwnerMap");
-	elem->second = newHandler;
+	map.at(fd) = newHandler;
 }
 
 }
@@ -1,27 +1,52 @@
 #pragma once
 
 #include <deque>
+#include <map>
 #include <memory>
-#include <unordered_map>
 #include <chrono>
 
+#include "FdTable.hpp"
+#include "Logger.hpp"
+
 #define IO_BUFFER_SIZE 1024
+#define READ_BUDGET (256 * 1024)
+#define DEFAULT_MAX_EVENTS 512
+#define DEFAULT_ACCEPT_BUDGET 64
+#define DEFAULT_CLIENT_POOL_SIZE 256
+#define DEFAULT_LISTEN_BACKLOG 511
+#define DEFAULT_DEFER_ACCEPT_SECS 1
+#define DEFAULT_OVERLOAD_RETRY_AFTER 1
+#define DEFAULT_MAX_REQUEST_LINE 8192
+#define DEFAULT_MAX_HEADER_LINE 8192
+#define DEFAULT_MAX_HEADER_SIZE (32 * 1024)
+#define DEFAULT_MAX_CONNECTION_BUFFER (1024 * 1024)
+#define PIPELINE_MAX_QUEUED 16
+#define PIPELINE_COALESCE_BYTES (16 * 1024)
+#define PIPELINE_READ_AHEAD (64 * 1024)
+#define RESPONSE_INLINE_FILE (16 * 1024)
+#define CONTINUE_RESPONSE "HTTP/1.1 100 Continue\r\n\r\n"
 #define CONTENT_TYPE_MULTIPART "multipart/form-data"
 #define CONTENT_TYPE_APP_FORM "application/x-www-form-urlencoded"
 #define LOCALHOST_URL "http://localhost:"
 #define DEFAULT_ERROR_DIR "web/www/errors/"
 
 class		Program;
+class		Worker;
 class		PostRequestHandler;
 class		Server;
 struct		IEpollFdOwner;
+struct		IEventBackend;
 class		IpPort;
 class		Client;
 enum class	HttpMethod;
 enum class	ClientState;
+enum class	TimerPhase;
 class		Cgi;
 class		ConfigParser;
 struct		ServerConfig;
+struct		ListenConfig;
+struct		GlobalConfig;
+struct		ConfigSnapshot;
 struct		Location;
 
 using		Time = std::chrono::steady_clock::time_point;
@@ -32,8 +57,21 @@ using		IpPortDeq = std::deque<IpPortPtr>;
 using		ServerPtr  = std::shared_ptr<Server>;
 using		ServerDeq = std::deque<ServerPtr>;
 
-using		ClientPtr = std::shared_ptr<Client>;
+using		WorkerPtr = std::shared_ptr<Worker>;
+using		WorkerDeq = std::deque<WorkerPtr>;
+
+using		EventBackendPtr = std::unique_ptr<IEventBackend>;
+
+struct		ClientDeleter
+{
+	void	operator()(Client *client) const;
+};
+
+using		ClientPtr = std::unique_ptr<Client, ClientDeleter>;
 using		ClientDeq = std::deque<ClientPtr>;
 
-using		FdClientMap = std::unordered_map<int, ClientPtr>;
-using		FdEpollOwnerMap = std::unordered_map<int, IEpollFdOwner*>;
+using		FdClientTable = FdTable<ClientPtr>;
+using		FdEpollOwnerTable = FdTable<IEpollFdOwner*>;
+using		AddrPortServersMap = std::map<std::string, ServerDeq>;
+using		AddrPortListenMap = std::map<std::string, ListenConfig>;
+using		ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
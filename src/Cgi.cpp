@@ -1,5 +1,5 @@
 #include "Cgi.hpp"
-#include "ConfigParser.hpp"
+#include "IpPort.hpp"
 
 void	Cgi::buildArgv()
 {
@@ -32,7 +32,7 @@ void	Cgi::buildEnv()
 {
 	_envStorage.clear();
 
-	_envStorage.push_back("REQUEST_METHOD=" + _client.getHttpMethod());
+	_envStorage.push_back("REQUEST_METHOD=" + std::string(tokens::methodName(_client.getHttpMethod())));
 	_envStorage.push_back(std::string("CONTENT_LENGTH=") + std::to_string(_client.getFileSize()));
 	_envStorage.push_back("SERVER_PROTOCOL=" + _client.getHttpVersion());
 	_envStorage.push_back(std::string("SCRIPT_FILENAME=") + _script);
@@ -43,7 +43,7 @@ void	Cgi::buildEnv()
 	_envStorage.push_back("REDIRECT_STATUS=200");
 	_envStorage.push_back("QUERY_STRING=" + _client.getQuery());
 
-	if (_client.getHttpMethod() == "POST")
+	if (_client.getHttpMethod() == HttpMethod::POST)
 		_envStorage.push_back(std::string("UPLOAD_DIR=") + _uploadDir);
 
 	_envp.clear();
@@ -52,11 +52,14 @@ void	Cgi::buildEnv()
 	_envp.push_back(nullptr);
 }
 
+// Close-on-exec, so a CGI started by another worker doesn't inherit these
+// ends and keep this script's stdin or stdout open past its own exit.
+// dup2 clears the flag on the copies that become the child's stdio.
 bool Cgi::createPipes(int inPipe[2], int outPipe[2])
 {
-	if (pipe(inPipe) == -1)
+	if (pipe2(inPipe, O_CLOEXEC) == -1)
 		return false;
-	if (pipe(outPipe) == -1)
+	if (pipe2(outPipe, O_CLOEXEC) == -1)
 	{
 		close(inPipe[STDIN_FILENO]);
 		close(inPipe[STDOUT_FILENO]);
@@ -89,26 +92,38 @@ void	Cgi::cleanupCgiFds()
 
 bool	Cgi::registerWithEpoll()
 {
-	epoll_event evIn;
-	evIn.events = EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR;
-	evIn.data.fd = _stdoutFd;
-	if (epoll_ctl(_client.getIpPort().getEpollFd(), EPOLL_CTL_ADD, _stdoutFd, &evIn) == -1)
+	uint32_t	edgeTriggerFlag = _client.getIpPort().getWorker().getEdgeTriggerFlag();
+
+	_stdoutEvents = EPOLLIN | edgeTriggerFlag;
+	_stdinEvents = edgeTriggerFlag;
+
+	IEventBackend		&backend = _client.getIpPort().getWorker().getEventBackend();
+	FdEpollOwnerTable	&handlers = _client.getHandlersTable();
+	handlers.emplace(_stdoutFd, &_client);
+	try
 	{
+		backend.add(_stdoutFd, _stdoutEvents, handlers.getToken(_stdoutFd));
+	}
+	catch (std::exception &e)
+	{
+		handlers.erase(_stdoutFd);
 		cleanupCgiFds();
 		return false;
 	}
-	_client.getHandlersMap().emplace(_stdoutFd, &_client);
 
-	epoll_event evOut;
-	evOut.events = EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR;
-	evOut.data.fd = _stdinFd;
-	if (epoll_ctl(_client.getIpPort().getEpollFd(), EPOLL_CTL_ADD, _stdinFd, &evOut) == -1)
+	handlers.emplace(_stdinFd, &_client);
+	try
 	{
-		_client.getHandlersMap().erase(_stdoutFd);
+		backend.add(_stdinFd, _stdinEvents, handlers.getToken(_stdinFd));
+	}
+	catch (std::exception &e)
+	{
+		backend.remove(_stdoutFd);
+		handlers.erase(_stdoutFd);
+		handlers.erase(_stdinFd);
 		cleanupCgiFds();
 		return false;
 	}
-	_client.getHandlersMap().emplace(_stdinFd, &_client);
 	return true;
 }
 
@@ -132,19 +147,20 @@ bool	Cgi::init()
 		close(outPipe[STDOUT_FILENO]);
 		return false;
 	}
+	// Only async-signal-safe calls until execve: the parent is threaded, so
+	// the child must not allocate, throw or run destructors
 	if (pid == 0)
 	{
+		sigset_t	emptyMask;
+		sigemptyset(&emptyMask);
+		sigprocmask(SIG_SETMASK, &emptyMask, nullptr);
 		if (dup2(inPipe[STDIN_FILENO], STDIN_FILENO) == -1
 			|| dup2(outPipe[STDOUT_FILENO], STDOUT_FILENO) == -1)
 		{
-			THROW_CHILD("dup2");
+			_exit(EXIT_FAILURE);
 		}
-		close(inPipe[STDIN_FILENO]);
-		close(inPipe[STDOUT_FILENO]);
-		close(outPipe[STDIN_FILENO]);
-		close(outPipe[STDOUT_FILENO]);
 		execve(_interpreter.c_str(), _argv.data(), _envp.data());
-		THROW_CHILD("execve");
+		_exit(EXIT_FAILURE);
 	}
 
 	close(inPipe[STDIN_FILENO]);
@@ -183,6 +199,60 @@ int	Cgi::killChild()
 	return status;
 }
 
+void	Cgi::terminate()
+{
+	closeStdin();
+	closeStdout();
+	killChild();
+}
+
+void	Cgi::closeStdin()
+{
+	if (_stdinFd == -1)
+		return;
+	_client.getIpPort().getWorker().getEventBackend().remove(_stdinFd);
+	_client.getHandlersTable().erase(_stdinFd);
+	close(_stdinFd);
+	_stdinFd = -1;
+}
+
+void	Cgi::closeStdout()
+{
+	if (_stdoutFd == -1)
+		return;
+	_client.getIpPort().getWorker().getEventBackend().remove(_stdoutFd);
+	_client.getHandlersTable().erase(_stdoutFd);
+	close(_stdoutFd);
+	_stdoutFd = -1;
+}
+
+// A pipe only gets readiness events while the client state actually uses it,
+// otherwise a level-triggered writable stdin would wake epoll_wait forever.
+void	Cgi::updateEpollInterest(ClientState state)
+{
+	uint32_t	edgeTriggerFlag = _client.getIpPort().getWorker().getEdgeTriggerFlag();
+	uint32_t	events;
+
+	if (_stdoutFd != -1)
+	{
+		events = (state == ClientState::READING_CGI_OUTPUT ? static_cast<uint32_t>(EPOLLIN) : 0) | edgeTriggerFlag;
+		if (events != _stdoutEvents)
+		{
+			_client.getIpPort().getWorker().getEventBackend().modify(_stdoutFd, events, _client.getHandlersTable().getToken(_stdoutFd));
+			_stdoutEvents = events;
+		}
+	}
+	if (_stdinFd != -1)
+	{
+		events = (state == ClientState::WRITING_CGI_INPUT ? static_cast<uint32_t>(EPOLLOUT) : 0) | edgeTriggerFlag;
+		if (events != _stdinEvents)
+		{
+			_client.getIpPort().getWorker().getEventBackend().modify(_stdinFd, events, _client.getHandlersTable().getToken(_stdinFd));
+			_stdinEvents = events;
+		}
+	}
+}
+
 // Getters + Setters
 
 int	Cgi::getStdinFd()
@@ -207,6 +277,8 @@ Cgi::Cgi(Client &client)
 	, _contentType("text/html")
 	, _stdinFd(-1)
 	, _stdoutFd(-1)
+	, _stdinEvents(0)
+	, _stdoutEvents(0)
 	, _pid(-1)
 	, _headersParsed(false)
 	, _interpreter()
@@ -1,69 +1,411 @@
 #include "Client.hpp"
+#include "Scan.hpp"
 
+// Reads until EAGAIN. Level-triggered mode stops after READ_BUDGET bytes
+// to stay fair to other connections, the rest raises the next event; in
+// edge-triggered mode no further event comes for queued bytes, so it drains.
+// End of input after some data is noted and answered once that is parsed.
 bool	Client::readRequest()
 {
-	char	buffer[IO_BUFFER_SIZE];
-	int		bytesRead = read(_clientFd, buffer, sizeof(buffer) - 1);
+	return readInput(SIZE_MAX);
+}
 
-	if (bytesRead > 0)
+// No single read goes past what max_connection_buffer and the global
+// buffer budget still allow, or past bufferCap, and each read is charged
+// before the next one. Input left in the socket at a limit is remembered:
+// edge-triggered mode re-arms the interest once the parsers have made room,
+// which has the kernel report it again, and read-ahead behind a response
+// stops until that response is done, so a level-triggered EPOLLIN doesn't
+// keep firing for input there is no room for.
+bool	Client::readInput(size_t bufferCap)
+{
+	Program			&program = _ipPort->getWorker().getProgram();
+	GlobalConfig	&config = program.getGlobalConfig();
+	bool			edgeTriggered = _ipPort->getWorker().isEdgeTriggered();
+	bool			reading = _state == ClientState::READING_REQUEST || _state == ClientState::GETTING_BODY;
+	size_t			total = 0;
+
+	if (_ipPort->getWorker().isCompletionBased())
+		return takeReceived();
+	while (edgeTriggered || total < READ_BUDGET)
 	{
-		buffer[bytesRead] = '\0';
-		_buffer.append(buffer, bytesRead);
-		_lastActivity = g_current_time;
-		return true;
+		size_t	held = _buffer.size() + _postHandler.getBufferedSize();
+		size_t	cap = static_cast<size_t>(config.maxConnectionBuffer);
+		size_t	room = held < cap ? cap - held : 0;
+		if (bufferCap < SIZE_MAX)
+			room = std::min(room, bufferCap > _buffer.size() ? bufferCap - _buffer.size() : 0);
+		if (!edgeTriggered)
+			room = std::min(room, READ_BUDGET - total);
+		if (config.maxBufferMemory > 0)
+		{
+			size_t	budget = program.getBufferMemory().available(config.maxBufferMemory);
+			if (budget == 0 && reading)
+				THROW_HTTP(503, "Buffer memory budget exhausted");
+			room = std::min(room, budget);
+		}
+		if (room == 0)
+		{
+			_readPending = true;
+			updateEpollInterest();
+			return true;
+		}
+
+		ssize_t	bytesRead = _buffer.readFrom(_clientFd, room);
+		if (bytesRead > 0)
+		{
+			total += static_cast<size_t>(bytesRead);
+			refreshTimer();
+			chargeMemory();
+		}
+		else if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		else
+		{
+			_inputClosed = true;
+			return total > 0;
+		}
 	}
-	else if (bytesRead == 0 || bytesRead == -1)
+	return true;
+}
+
+// Completion mode: receive() already put the bytes in the buffer, so they
+// are only charged here. The multishot recv doesn't stop at the limits the
+// way a read does; the interest drops EPOLLIN at them, which cancels it,
+// and chargeBuffers refuses what still went past.
+bool	Client::takeReceived()
+{
+	bool	received = _receivedBytes > 0;
+
+	if (received)
+	{
+		_receivedBytes = 0;
+		refreshTimer();
+		chargeMemory();
+	}
+	return received || !_inputClosed;
+}
+
+void	Client::receive(const Completion &completion)
+{
+	if (completion.result > 0)
+	{
+		_buffer.append(completion.data, static_cast<size_t>(completion.result));
+		_receivedBytes += static_cast<size_t>(completion.result);
+	}
+	else
+		_inputClosed = true;
+}
+
+// Keeps this connection's share of the global buffer budget in step with
+// what its read-side buffers hold, once the parsers have taken what they
+// can. Input that still doesn't fit is refused: as too large once it fills
+// the per-connection cap, as unavailable past the global one.
+void	Client::chargeBuffers()
+{
+	GlobalConfig	&config = _ipPort->getWorker().getProgram().getGlobalConfig();
+	bool			reading = _state == ClientState::READING_REQUEST || _state == ClientState::GETTING_BODY;
+	size_t			buffered = _buffer.size() + _postHandler.getBufferedSize();
+
+	// Reads stop at the cap, so a full buffer the parsers left alone is stuck
+	if (reading && buffered >= static_cast<size_t>(config.maxConnectionBuffer))
+	{
+		if (_state == ClientState::READING_REQUEST)
+			THROW_HTTP(431, "Connection buffer limit reached");
+		THROW_HTTP(413, "Connection buffer limit reached");
+	}
+	chargeMemory();
+}
+
+// A response on its way out is never cut short, so its growth is only counted
+void	Client::chargeMemory()
+{
+	Program			&program = _ipPort->getWorker().getProgram();
+	GlobalConfig	&config = program.getGlobalConfig();
+	bool			reading = _state == ClientState::READING_REQUEST || _state == ClientState::GETTING_BODY;
+	size_t			footprint = _buffer.capacity() + _postHandler.getBufferCapacity();
+
+	if (footprint < _chargedMemory)
+		program.getBufferMemory().release(_chargedMemory - footprint);
+	else if (footprint > _chargedMemory
+		&& !program.getBufferMemory().tryCharge(footprint - _chargedMemory, reading ? config.maxBufferMemory : 0))
+		THROW_HTTP(503, "Buffer memory budget exhausted");
+	_chargedMemory = footprint;
+}
+
+void	Client::releaseBuffers()
+{
+	if (_chargedMemory)
+		_ipPort->getWorker().getProgram().getBufferMemory().release(_chargedMemory);
+	_chargedMemory = 0;
+}
+
+// Pipelined requests are read while a response goes out so the peer's
+// writes don't back up behind it; PIPELINE_READ_AHEAD bounds what is held.
+void	Client::readAhead()
+{
+	readInput(PIPELINE_READ_AHEAD);
+	chargeMemory();
+	updateEpollInterest();
+}
+
+// A finished response is held back, rather than sent, while the next
+// request's head is already buffered and the held bytes stay small.
+bool	Client::canQueueResponse()
+{
+	if (_state != ClientState::SENDING_RESPONSE || !_keepAlive || _sendTask
+		|| _queuedResponses >= PIPELINE_MAX_QUEUED || _ipPort->getWorker().isDraining())
 		return false;
+	size_t	pending = _responseBuffer.size() - _responseOffset + (_fileSize - _fileOffset);
+	if (pending > PIPELINE_COALESCE_BYTES || _buffer.empty())
+		return false;
+	// A malformed head is reported once the held responses are out
+	return _parser.feed(_buffer.view());
+}
+
+// Appends a small file body to the held bytes so the next response can
+// follow it in the same write, then readies the client for that request.
+void	Client::queueResponse()
+{
+	if (_fileFd >= 0 && _fileOffset < _fileSize)
+	{
+		size_t	start = _responseBuffer.size();
+		size_t	length = _fileSize - _fileOffset;
+		_responseBuffer.resize(start + length);
+		ssize_t	readBytes = pread(_fileFd, &_responseBuffer[start], length, _fileOffset);
+		if (readBytes < 0)
+			THROW_ERRNO("pread");
+		if (static_cast<size_t>(readBytes) != length)
+			THROW("File shrank while being served");
+	}
+	closeFile();
+	_postHandler.resetBodyState();
+	++_queuedResponses;
+	setState(ClientState::READING_REQUEST);
+	utils::changeEpollHandler(_handlersTable, _clientFd, _ipPort);
+}
+
+// The next request went somewhere that doesn't answer right away (a body
+// still arriving, a CGI), so the held responses go out now instead. What
+// the socket doesn't take stays held, with EPOLLOUT armed for the rest.
+// Returns false once the peer can no longer be written to.
+bool	Client::flushQueuedResponses()
+{
+	while (_responseOffset < _responseBuffer.size())
+	{
+		ssize_t	bytesSent = send(_clientFd, _responseBuffer.data() + _responseOffset,
+			_responseBuffer.size() - _responseOffset, 0);
+		if (bytesSent <= 0)
+		{
+			updateEpollInterest();
+			return bytesSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		_responseOffset += static_cast<size_t>(bytesSent);
+		refreshTimer();
+	}
+	_responseBuffer.clear();
+	_responseOffset = 0;
+	updateEpollInterest();
 	return true;
 }
 
-void	Client::sendResponse()
+bool	Client::hasQueuedResponses()
 {
-	std::cout << "Sending response..." << std::endl;
-	int		bytesSent = 0;
+	return _responseOffset < _responseBuffer.size();
+}
 
-	if (_responseOffset < _responseBuffer.size())
+// A file body of up to RESPONSE_INLINE_FILE bytes is read and leaves with
+// the headers in one writev, so a small response is one segment. A larger
+// one follows the headers with sendfile in the same call, the headers held
+// back by MSG_MORE, or by TCP_CORK for servers with tcp_nopush on.
+ssize_t	Client::sendChunk()
+{
+	size_t	pending = _responseBuffer.size() - _responseOffset;
+	size_t	fileLeft = _fileFd >= 0 && _fileOffset < _fileSize ? _fileSize - _fileOffset : 0;
+
+	if (pending && fileLeft && fileLeft <= RESPONSE_INLINE_FILE)
+		return sendWithInlineFile(pending, fileLeft);
+	if (pending && fileLeft)
+		return sendHeadersAndFile(pending, fileLeft);
+	if (pending)
 	{
-		const char* buf = _responseBuffer.c_str() + _responseOffset;
-		size_t toSend = _responseBuffer.size() - _responseOffset;
-		bytesSent = send(_clientFd, buf, toSend, 0);
+		ssize_t	bytesSent = send(_clientFd, _responseBuffer.data() + _responseOffset, pending, 0);
 		if (bytesSent > 0)
 			_responseOffset += static_cast<size_t>(bytesSent);
+		return bytesSent;
 	}
-	else if (_fileOffset < _fileSize && _fileFd >= 0)
+	if (fileLeft)
 	{
-		off_t offset = static_cast<off_t>(_fileOffset);
-		bytesSent = sendfile(_clientFd, _fileFd, &offset, _fileSize - offset);
+		off_t	offset = static_cast<off_t>(_fileOffset);
+		ssize_t	bytesSent = sendfile(_clientFd, _fileFd, &offset, fileLeft);
 		if (bytesSent > 0)
 			_fileOffset += static_cast<size_t>(bytesSent);
+		if (_fileOffset == _fileSize)
+			setCork(false);
+		return bytesSent;
 	}
+	return 0;
+}
 
-	if (_responseOffset >= _responseBuffer.size()
-		&& _fileOffset >= _fileSize)
+ssize_t	Client::sendWithInlineFile(size_t pending, size_t fileLeft)
+{
+	char	body[RESPONSE_INLINE_FILE];
+	iovec	iov[2];
+
+	ssize_t	readBytes = pread(_fileFd, body, fileLeft, _fileOffset);
+	if (readBytes != static_cast<ssize_t>(fileLeft))
 	{
-		_fileOffset = 0;
-		_fileSize = 0;
-		_responseOffset = 0;
-		_responseBuffer.clear();
-
-		if (_keepAlive == false)
-			return _ipPort.closeConnection(_clientFd);
-
-		_postHandler.resetBodyState();
-		closeFile();
-		_state = ClientState::READING_REQUEST;
-		utils::changeEpollHandler(_handlersMap, _clientFd, &_ipPort);
-		return ;
+		// Shrunk or unreadable: fail the send rather than wait for more
+		errno = readBytes < 0 ? errno : EIO;
+		return -1;
+	}
+	iov[0].iov_base = &_responseBuffer[_responseOffset];
+	iov[0].iov_len = pending;
+	iov[1].iov_base = body;
+	iov[1].iov_len = fileLeft;
+
+	ssize_t	bytesSent = writev(_clientFd, iov, 2);
+	if (bytesSent <= 0)
+		return bytesSent;
+	size_t	sent = static_cast<size_t>(bytesSent);
+	size_t	fromHeaders = sent < pending ? sent : pending;
+	_responseOffset += fromHeaders;
+	_fileOffset += sent - fromHeaders;
+	return bytesSent;
+}
+
+ssize_t	Client::sendHeadersAndFile(size_t pending, size_t fileLeft)
+{
+	if (_ownerServer && _ownerServer->isTcpNopush())
+		setCork(true);
+	ssize_t	bytesSent = send(_clientFd, _responseBuffer.data() + _responseOffset, pending, _corked ? 0 : MSG_MORE);
+	if (bytesSent <= 0)
+		return bytesSent;
+	_responseOffset += static_cast<size_t>(bytesSent);
+	if (static_cast<size_t>(bytesSent) < pending)
+		return bytesSent;
+
+	off_t	offset = static_cast<off_t>(_fileOffset);
+	ssize_t	fileSent = sendfile(_clientFd, _fileFd, &offset, fileLeft);
+	if (fileSent > 0)
+		_fileOffset += static_cast<size_t>(fileSent);
+	if (_fileOffset == _fileSize)
+		setCork(false);
+	// The headers went out, so a full socket only matters on the next call
+	return bytesSent + (fileSent > 0 ? fileSent : 0);
+}
+
+// Socket options are best effort: failing costs coalescing, not the response
+void	Client::setCork(bool on)
+{
+	int	value = on;
+
+	if (_corked == on)
+		return;
+	setsockopt(_clientFd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+	_corked = on;
+}
+
+void	Client::setNoDelay(bool on)
+{
+	int	value = on;
+
+	if (_noDelay == on)
+		return;
+	setsockopt(_clientFd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+	_noDelay = on;
+}
+
+// Straight-line send loop; each co_await parks the frame until the socket
+// is reported again. Failure is left in _sendFailed so finishResponse
+// decides between closing and keep-alive in one place.
+// Level-triggered mode yields after every write to stay fair to other fds.
+Task	Client::sendResponseTask()
+{
+	bool	edgeTriggered = _ipPort->getWorker().isEdgeTriggered();
+
+	LOG_DEBUG("Sending response to fd ", _clientFd);
+	while (_responseOffset < _responseBuffer.size() || _fileOffset < _fileSize)
+	{
+		ssize_t	bytesSent = sendChunk();
+		if (bytesSent > 0)
+		{
+			refreshTimer();
+			if (edgeTriggered)
+				continue;
+		}
+		else if (bytesSent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			_sendFailed = true;
+			co_return;
+		}
+		co_await _socketEvent;
+	}
+}
+
+// Completion mode: every step is one send the backend carries out on its
+// own, so there is no EAGAIN to wait out; the frame resumes on its result.
+Task	Client::sendResponseCompletionTask()
+{
+	LOG_DEBUG("Sending response to fd ", _clientFd);
+	while (_responseOffset < _responseBuffer.size() || _fileOffset < _fileSize)
+	{
+		size_t	pending = _responseBuffer.size() - _responseOffset;
+		submitSend();
+		co_await _socketEvent;
+		if (_socketEvent.result <= 0)
+		{
+			_sendFailed = true;
+			co_return;
+		}
+		refreshTimer();
+		size_t	sent = static_cast<size_t>(_socketEvent.result);
+		size_t	fromHeaders = sent < pending ? sent : pending;
+		_responseOffset += fromHeaders;
+		_fileOffset += sent - fromHeaders;
 	}
+}
 
-	if (bytesSent > 0)
+// The backend copies the bytes and reads the file chunk itself, so nothing
+// here has to stay put while the send is in flight
+void	Client::submitSend()
+{
+	size_t		pending = _responseBuffer.size() - _responseOffset;
+	size_t		fileLeft = _fileFd >= 0 && _fileOffset < _fileSize ? _fileSize - _fileOffset : 0;
+	FileChunk	chunk{_fileFd, fileLeft, static_cast<off_t>(_fileOffset)};
+
+	_ipPort->getWorker().getEventBackend().send(_clientFd, _responseBuffer.data() + _responseOffset,
+		pending, fileLeft ? &chunk : nullptr);
+	_sendInFlight = true;
+}
+
+void	Client::finishResponse()
+{
+	if (_sendFailed || _keepAlive == false || _ipPort->getWorker().isDraining())
 	{
-		_lastActivity = g_current_time;
+		_ipPort->closeConnection(_clientFd);
+		return;
 	}
-	else if (bytesSent == 0 || bytesSent == -1)
+	_fileOffset = 0;
+	_fileSize = 0;
+	_responseOffset = 0;
+	_responseBuffer.clear();
+	_queuedResponses = 0;
+	setCork(false);
+	_postHandler.resetBodyState();
+	if (_buffer.empty() && _buffer.capacity() > CLIENT_MAX_RETAINED_BUFFER)
 	{
-		_ipPort.closeConnection(_clientFd);
+		_buffer.release(CLIENT_MAX_RETAINED_BUFFER);
+		chargeBuffers();
 	}
+	closeFile();
+	setState(ClientState::READING_REQUEST);
+	utils::changeEpollHandler(_handlersTable, _clientFd, _ipPort);
+	// Pipelined requests that arrived during the send are answered now,
+	// not when the peer next writes
+	if (!_buffer.empty())
+		_ipPort->processRequests(_clientsTable.at(_clientFd));
+	else if (_inputClosed)
+		_ipPort->closeConnection(_clientFd);
 }
 
 void	Client::closeFile()
@@ -105,16 +447,34 @@ void	Client::handleEpollEvent(epoll_event &ev, int eventFd)
 				handleCgiStdoutEvent();
 				return;
 			}
+			if (eventFd == _clientFd && _state == ClientState::SENDING_RESPONSE && (ev.events & EPOLLIN))
+				readAhead();
 		}
-		if (ev.events & EPOLLOUT)
+		if (ev.events & (EPOLLOUT | EPOLLERR))
 		{
 			if (eventFd == _clientFd && _state == ClientState::SENDING_RESPONSE)
 			{
-				sendResponse();
+				// Completion mode: only the send's own result resumes the task
+				if (_sendInFlight)
+					return;
+				if (!_sendTask)
+				{
+					_sendFailed = false;
+					_sendTask = _ipPort->getWorker().isCompletionBased()
+						? sendResponseCompletionTask() : sendResponseTask();
+				}
+				_socketEvent.events = ev.events;
+				if (!_sendTask.resume())
+					finishResponse();
+				else if (_sendInFlight)
+					updateEpollInterest();
 			}
 			else if (eventFd == _cgi.getStdinFd() && _state == ClientState::WRITING_CGI_INPUT)
 			{
-				handleCgiStdinEvent();
+				if (!_cgiInputTask)
+					_cgiInputTask = writeCgiInputTask();
+				_cgiStdinEvent.events = ev.events;
+				_cgiInputTask.resume();
 			}
 		}
 	}
@@ -122,91 +482,106 @@ void	Client::handleEpollEvent(epoll_event &ev, int eventFd)
 	{
 		resetRequestData();
 		_buffer.clear();
-		auto FdclientPtr = _ipPort.getClientsMap().find(_clientFd);
 		try {
-			_ipPort.generateResponse(FdclientPtr->second, "", e.getStatusCode());
+			_ipPort->generateResponse(_clientsTable.at(_clientFd), "", e.getStatusCode());
 		}
 		catch (std::exception &e){
-			_ipPort.closeConnection(eventFd);
+			_ipPort->closeConnection(eventFd);
 		}
 	}
 	catch (std::exception &e)
 	{
-		_ipPort.closeConnection(eventFd);
+		_ipPort->closeConnection(eventFd);
 	}
 }
 
-void	Client::handleCgiStdoutEvent()
+// Completion mode: received bytes are stored and then handled by whichever
+// owner has the socket, as if it had been reported readable; a finished
+// send resumes the send task the same way.
+void	Client::handleCompletion(Completion &completion, int eventFd)
 {
-	char	buf[IO_BUFFER_SIZE];
+	epoll_event	ev{};
 
-	int readBytes = read(_cgi.getStdoutFd(), buf, sizeof(buf));
-	if (readBytes > 0)
+	ev.data.u64 = completion.token;
+	if (completion.op == CompletionOp::SEND)
 	{
-		_cgiBuffer.append(buf, readBytes);
-		_lastActivity = g_current_time;
+		_sendInFlight = false;
+		_socketEvent.result = completion.result;
+		ev.events = EPOLLOUT;
 	}
 	else
 	{
-		epoll_ctl(_ipPort.getEpollFd(), EPOLL_CTL_DEL, _cgi.getStdoutFd(), 0);
-		close(_cgi.getStdoutFd());
-		_handlersMap.erase(_cgi.getStdoutFd());
-		if (readBytes == 0)
-		{
-			int status = _cgi.reapChild();
-			if (status != 0)
-			{
-				closeFile();
-				std::string	errorPage = _ownerServer->getCustomErrorPage(status);
-				ClientPtr	self = _clientsMap.at(_clientFd);
-				_ipPort.generateResponse(self, errorPage, 500);
-				return;
-			}
-			parseCgiOutput();
-			utils::changeEpollHandler(_handlersMap, _clientFd, this);
-			return;
-		}
-		else
-			THROW_ERRNO("read CGI stdout");
+		receive(completion);
+		ev.events = EPOLLIN;
 	}
+	if (IEpollFdOwner **owner = _handlersTable.find(eventFd))
+		(*owner)->handleEpollEvent(ev, eventFd);
 }
 
-void	Client::handleCgiStdinEvent()
+void	Client::handleCgiStdoutEvent()
 {
-	char buf[IO_BUFFER_SIZE];
+	char	buf[IO_BUFFER_SIZE];
+	bool	edgeTriggered = _ipPort->getWorker().isEdgeTriggered();
+	int		readBytes;
 
-	int	readBytes = read(_fileFd, buf, sizeof(buf));
-	if (readBytes > 0)
+	while ((readBytes = read(_cgi.getStdoutFd(), buf, sizeof(buf))) > 0)
 	{
-		int	wroteBytes = write(_cgi.getStdinFd(), buf, readBytes);
-		if (wroteBytes == -1)
-		{
-			THROW_HTTP(500, "write failed in CGI");
-		}
-		else if (wroteBytes < readBytes)
-		{
-			lseek(_fileFd, static_cast<off_t>(wroteBytes - readBytes), SEEK_CUR);
+		_cgiBuffer.append(buf, readBytes);
+		if (!edgeTriggered)
 			return;
-		}
-		_lastActivity = g_current_time;
 	}
-	else
+	if (readBytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return;
+
+	_cgi.closeStdout();
+	if (readBytes == 0)
 	{
-		epoll_ctl(_ipPort.getEpollFd(), EPOLL_CTL_DEL, _cgi.getStdinFd(), 0);
-		close(_cgi.getStdinFd());
-		_handlersMap.erase(_cgi.getStdinFd());
-		if (readBytes == 0)
+		int status = _cgi.reapChild();
+		if (status != 0)
 		{
 			closeFile();
-			_state = ClientState::READING_CGI_OUTPUT;
+			std::string	errorPage = _ownerServer->getCustomErrorPage(status);
+			_ipPort->generateResponse(_clientsTable.at(_clientFd), errorPage, 500);
 			return;
 		}
-		else
+		parseCgiOutput();
+		utils::changeEpollHandler(_handlersTable, _clientFd, this);
+		return;
+	}
+	else
+		THROW_ERRNO("read CGI stdout");
+}
+
+// Streams the spooled request body into the CGI's stdin. A chunk the pipe
+// only partly accepted stays in the frame until the pipe drains.
+Task	Client::writeCgiInputTask()
+{
+	char	buf[IO_BUFFER_SIZE];
+	bool	edgeTriggered = _ipPort->getWorker().isEdgeTriggered();
+	ssize_t	readBytes;
+
+	while ((readBytes = read(_fileFd, buf, sizeof(buf))) > 0)
+	{
+		ssize_t	offset = 0;
+		while (offset < readBytes)
 		{
-			THROW_HTTP(500, "read temp body file");
+			ssize_t	wroteBytes = write(_cgi.getStdinFd(), buf + offset, readBytes - offset);
+			if (wroteBytes > 0)
+				offset += wroteBytes;
+			else if (wroteBytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				co_await _cgiStdinEvent;
+			else
+				THROW_HTTP(500, "write failed in CGI");
 		}
+		if (!edgeTriggered)
+			co_await _cgiStdinEvent;
 	}
 
+	_cgi.closeStdin();
+	if (readBytes != 0)
+		THROW_HTTP(500, "read temp body file");
+	closeFile();
+	setState(ClientState::READING_CGI_OUTPUT);
 }
 
 bool	Client::parseCgiOutput()
@@ -214,11 +589,11 @@ bool	Client::parseCgiOutput()
 	_fileSize = 0;
 	_fileOffset = 0;
 
-	std::string::size_type	pos = _cgiBuffer.find("\r\n\r\n");
+	std::string::size_type	pos = scan::findDoubleCrlf(_cgiBuffer.data(), _cgiBuffer.size());
 	std::string				headers;
 	std::string				body;
 	int						code = 200;
-	if (pos != std::string::npos)
+	if (pos != _cgiBuffer.size())
 	{
 		headers = _cgiBuffer.substr(0, pos);
 		body = _cgiBuffer.substr(pos + 4);
@@ -248,26 +623,105 @@ bool	Client::parseCgiOutput()
 			}
 			if (code >= 400)
 				THROW_HTTP(code, "Cgi returned error");
-			statusLine = "HTTP/1.1 " + std::to_string(code) + " " + _ipPort.getStatusText(code) + "\r\n";
+			statusLine = "HTTP/1.1 " + std::to_string(code) + " " + _ipPort->getStatusText(code) + "\r\n";
 		}
 		else
 			outHeaders += line + "\r\n";
 	}
 	_keepAlive = false;
-	_responseBuffer = statusLine;
+	_responseBuffer += statusLine;
 	_responseBuffer += outHeaders;
 	_responseBuffer += "Content-Length: " + std::to_string(body.size()) + "\r\n";
 	_responseBuffer += "Connection: close\r\n\r\n";
 	_responseBuffer += body;
-	_responseOffset = 0;
-	_state = ClientState::SENDING_RESPONSE;
+	setState(ClientState::SENDING_RESPONSE);
 	_cgiBuffer.clear();
-	std::cout << "HTTP code for client: " << code << std::endl;
+	LOG_DEBUG("HTTP code for client: ", code);
 	return true;
 }
 
+void	Client::setState(ClientState s)
+{
+	_state = s;
+	switch (_state)
+	{
+		case ClientState::READING_REQUEST:
+			armTimer(TimerPhase::KEEPALIVE);
+			break;
+		case ClientState::GETTING_BODY:
+			armTimer(TimerPhase::BODY);
+			break;
+		case ClientState::SENDING_RESPONSE:
+			armTimer(TimerPhase::SEND);
+			break;
+		default:
+			if (_timerPhase != TimerPhase::CGI)
+				armTimer(TimerPhase::CGI);
+	}
+	updateEpollInterest();
+}
+
+void	Client::armTimer(TimerPhase phase)
+{
+	Worker	&worker = _ipPort->getWorker();
+
+	_timerPhase = phase;
+	_timer.key = _clientFd;
+	worker.getTimerWheel().schedule(_timer, g_current_time + worker.getPhaseTimeout(phase));
+	_idleNode.key = _clientFd;
+	_idleNode.expiry = _timer.expiry;
+	if (phase == TimerPhase::KEEPALIVE)
+		_ipPort->getIdleList().pushBack(_idleNode);
+	else
+		_ipPort->getIdleList().remove(_idleNode);
+}
+
+// Header and CGI deadlines are absolute so a trickling peer can't stretch
+// them; body and send deadlines are idle timeouts renewed on every progress.
+void	Client::refreshTimer()
+{
+	if (_timerPhase == TimerPhase::KEEPALIVE)
+		armTimer(TimerPhase::HEADER);
+	else if (_timerPhase == TimerPhase::BODY || _timerPhase == TimerPhase::SEND)
+		armTimer(_timerPhase);
+}
+
+// The interest set follows the state: a client waiting on its CGI or idle in
+// keep-alive between writes must not be woken just because the socket is writable.
+// In completion mode EPOLLOUT only starts the send task, whose sends then
+// complete on their own.
+void	Client::updateEpollInterest()
+{
+	uint32_t	events = _ipPort->getWorker().getSocketEventFlags();
+
+	if (_state == ClientState::READING_REQUEST || _state == ClientState::GETTING_BODY)
+	{
+		if (!_inputClosed)
+			events |= EPOLLIN;
+		if (hasQueuedResponses())
+			events |= EPOLLOUT;
+	}
+	else if (_state == ClientState::SENDING_RESPONSE)
+	{
+		if (!_sendInFlight)
+			events |= EPOLLOUT;
+		if (!_inputClosed && !_readPending && _buffer.size() < PIPELINE_READ_AHEAD)
+			events |= EPOLLIN;
+	}
+	// Re-arming in edge-triggered mode reports input a read left behind
+	if (events != _events || (_readPending && (events & EPOLLIN)))
+	{
+		_ipPort->getWorker().getEventBackend().modify(_clientFd, events, _handlersTable.getToken(_clientFd));
+		_events = events;
+		if (events & EPOLLIN)
+			_readPending = false;
+	}
+	_cgi.updateEpollInterest(_state);
+}
+
 void	Client::resetRequestData()
 {
+	_parser.reset();
 	_postHandler.resetBodyState();
 	_contentLen = 0;
 	_chunked = false;
@@ -277,33 +731,96 @@ void	Client::resetRequestData()
 	_fileType = FileType::REGULAR;
 	_cgiBuffer.clear();
 	_keepAlive = false;
+	_expectContinue = false;
+	_sendTask = Task();
+	_cgiInputTask = Task();
 	closeFile();
 }
 
+// Puts a pooled client back into the state the constructor leaves it in,
+// bound to a freshly accepted connection.
+void	Client::reuse(int clientFd, IpPort &owner)
+{
+	_clientFd = clientFd;
+	_ipPort = &owner;
+	_state = ClientState::READING_REQUEST;
+	_events = EPOLLIN | owner.getWorker().getSocketEventFlags();
+	_inputClosed = false;
+	_queuedResponses = 0;
+	_readPending = false;
+	_corked = false;
+	_noDelay = false;
+	_sendInFlight = false;
+	_receivedBytes = 0;
+	_parser.setLimits(owner.getWorker().getHeadLimits());
+	armTimer(TimerPhase::HEADER);
+}
+
+// Cuts every link the worker has to this client as its connection closes:
+// timers, the idle list and the CGI pipes. The object itself is only
+// recycled once the current event batch is over.
+void	Client::detach()
+{
+	Worker	&worker = _ipPort->getWorker();
+
+	worker.getTimerWheel().cancel(_timer);
+	_ipPort->getIdleList().remove(_idleNode);
+	_cgi.terminate();
+}
+
+// Releases everything tied to the connection but keeps the object, and the
+// capacity of its small buffers, for the next one.
+void	Client::recycle()
+{
+	detach();
+	releaseBuffers();
+	resetRequestData();
+	if (_clientFd != -1)
+		close(_clientFd);
+	_clientFd = -1;
+
+	_buffer.clear();
+	_buffer.release(CLIENT_MAX_RETAINED_BUFFER);
+	_responseBuffer.clear();
+	if (_responseBuffer.capacity() > CLIENT_MAX_RETAINED_BUFFER)
+		_responseBuffer.shrink_to_fit();
+	_responseOffset = 0;
+	_ownerServer.reset();
+	_httpMethod = HttpMethod::UNKNOWN;
+	_httpPath.clear();
+	_httpVersion.clear();
+	_hostHeader.clear();
+	_multipartBoundary.clear();
+	_resolvedPath.clear();
+	_redirectCode = 0;
+}
+
 // Getters + Setters
 
 int				Client::getFd() { return _clientFd; }
 
-Time			Client::getLastActivity() { return _lastActivity; }
-void			Client::setLastActivity(Time t) { _lastActivity = t; }
-
-std::string&	Client::getBuffer() { return _buffer; }
-void			Client::setBuffer(const std::string &v) { _buffer = v; }
+ReadBuffer&		Client::getBuffer() { return _buffer; }
+HttpRequestParser&	Client::getParser() { return _parser; }
 
 std::string&	Client::getResponseBuffer() { return _responseBuffer; }
 void			Client::setResponseBuffer(const std::string &v) { _responseBuffer = v; }
+void			Client::appendResponse(std::string_view v) { _responseBuffer.append(v); }
 
 size_t			Client::getResponseOffset() { return _responseOffset; }
 void			Client::setResponseOffset(size_t v) { _responseOffset = v; }
 
+bool			Client::isInputClosed() { return _inputClosed; }
+
 ClientState		Client::getState() { return _state; }
-void			Client::setState(ClientState s) { _state = s; }
+TimerPhase		Client::getTimerPhase() { return _timerPhase; }
+
+uint32_t		Client::getEpollEvents() { return _events; }
 
 ServerPtr&		Client::getOwnerServer() { return _ownerServer; }
 void			Client::setOwnerServer(const ServerPtr &srv) { _ownerServer = srv; }
 
-std::string&	Client::getHttpMethod() { return _httpMethod; }
-void			Client::setHttpMethod(const std::string &v) { _httpMethod = v; }
+HttpMethod		Client::getHttpMethod() { return _httpMethod; }
+void			Client::setHttpMethod(HttpMethod v) { _httpMethod = v; }
 
 std::string&	Client::getHttpPath() { return _httpPath; }
 void			Client::setHttpPath(const std::string &v) { _httpPath = v; }
@@ -323,6 +840,9 @@ void			Client::setChunked(bool v) { _chunked = v; }
 bool			Client::isKeepAlive() { return _keepAlive; }
 void			Client::setKeepAlive(bool v) { _keepAlive = v; }
 
+bool			Client::isExpectingContinue() { return _expectContinue; }
+void			Client::setExpectContinue(bool v) { _expectContinue = v; }
+
 std::string&	Client::getHostHeader() { return _hostHeader; }
 void			Client::setHostHeader(const std::string &v) { _hostHeader = v; }
 
@@ -356,38 +876,51 @@ void			Client::setFileSize(int sz) { _fileSize = sz; }
 Cgi&			Client::getCgi() { return _cgi; }
 PostRequestHandler&	Client::getPostRequestHandler() { return _postHandler; }
 
-FdClientMap&		Client::getClientsMap() { return _clientsMap; }
-FdEpollOwnerMap&	Client::getHandlersMap() { return _handlersMap; }
-IpPort&				Client::getIpPort() { return _ipPort; }
-
-bool			Client::isTimeout() { return _isTimeout; }
-void			Client::setTimeout(bool Timeout) { _isTimeout = Timeout; }
+FdClientTable&		Client::getClientsTable() { return _clientsTable; }
+FdEpollOwnerTable&	Client::getHandlersTable() { return _handlersTable; }
+IpPort&				Client::getIpPort() { return *_ipPort; }
 
 // Constructors + Destructor
 
 Client::Client(int clientFd, IpPort &owner)
 	: _clientFd{clientFd}
-	, _lastActivity{g_current_time}
-	, _buffer()
+	, _timerPhase{TimerPhase::HEADER}
 	, _responseOffset{0}
 	, _state(ClientState::READING_REQUEST)
-	, _clientsMap(owner.getClientsMap())
-	, _handlersMap(owner.getHandlersMap())
-	, _ipPort(owner)
+	, _events{EPOLLIN | owner.getWorker().getSocketEventFlags()}
+	, _clientsTable(owner.getClientsTable())
+	, _handlersTable(owner.getHandlersTable())
+	, _ipPort(&owner)
 	, _ownerServer(nullptr)
+	, _httpMethod(HttpMethod::UNKNOWN)
 	, _chunked(false)
 	, _keepAlive(false)
+	, _expectContinue(false)
 	, _hostHeader()
 	, _fileFd{-1}
 	, _fileSize{0}
 	, _fileOffset{0}
 	, _cgi{*this}
-	, _postHandler{_ipPort}
-	, _isTimeout(false)
-{}
+	, _postHandler{}
+	, _sendFailed{false}
+	, _inputClosed{false}
+	, _queuedResponses{0}
+	, _chargedMemory{0}
+	, _readPending{false}
+	, _corked{false}
+	, _noDelay{false}
+	, _sendInFlight{false}
+	, _receivedBytes{0}
+{
+	_parser.setLimits(owner.getWorker().getHeadLimits());
+	armTimer(TimerPhase::HEADER);
+}
 
 Client::~Client()
 {
+	releaseBuffers();
+	_ipPort->getWorker().getTimerWheel().cancel(_timer);
+	_ipPort->getIdleList().remove(_idleNode);
 	if (_clientFd != -1)
 		close(_clientFd);
 	if (_fileFd != -1)
@@ -0,0 +1,50 @@
+#include "ClientPool.hpp"
+#include "Worker.hpp"
+#include "IpPort.hpp"
+
+void	ClientDeleter::operator()(Client *client) const
+{
+	client->getIpPort().getWorker().getClientPool().release(client);
+}
+
+ClientPtr	ClientPool::acquire(int clientFd, IpPort &owner)
+{
+	if (_free.empty())
+		return ClientPtr(new Client(clientFd, owner));
+	Client	*client = _free.back();
+	_free.pop_back();
+	client->reuse(clientFd, owner);
+	return ClientPtr(client);
+}
+
+void	ClientPool::release(Client *client)
+{
+	if (_free.size() >= _highWaterMark)
+	{
+		delete client;
+		return;
+	}
+	client->recycle();
+	_free.push_back(client);
+}
+
+// Getters + Setters
+
+size_t	ClientPool::getIdleCount()
+{
+	return _free.size();
+}
+
+// Constructors + Destructor
+
+ClientPool::ClientPool(size_t highWaterMark)
+	: _highWaterMark{highWaterMark}
+{
+	_free.reserve(highWaterMark);
+}
+
+ClientPool::~ClientPool()
+{
+	for (Client *client : _free)
+		delete client;
+}
@@ -1,4 +1,6 @@
 #include "ConfigParser.hpp"
+#include "Program.hpp"
+#include "Server.hpp"
 
 std::string ConfigParser::trim(const std::string& str) {
 	size_t first = str.find_first_not_of(" \t\r\n");
@@ -26,11 +28,8 @@ int ConfigParser::parseHttpMethods(const std::string& methods) {
 	int result = 0;
 	std::vector<std::string> methodList = split(methods, ' ');
 
-	for (const auto& method : methodList) {
-		if (method == "GET") result |= static_cast<int>(HttpMethod::GET);
-		else if (method == "POST") result |= static_cast<int>(HttpMethod::POST);
-		else if (method == "DELETE") result |= static_cast<int>(HttpMethod::DELETE);
-	}
+	for (const auto& method : methodList)
+		result |= static_cast<int>(tokens::lookupMethod(method));
 	return result;
 }
 
@@ -86,6 +85,10 @@ void ConfigParser::parseLocationDirective(const std::string& line, Location& loc
 		if (token == "on") {
 			location.isCgi = true;
 		}
+	} else if (directive == "tcp_nodelay") {
+		location.tcpNodelay = (getFirstToken(rest) == "on");
+	} else {
+		throw std::runtime_error("Unknown location directive: " + directive);
 	}
 }
 
@@ -127,6 +130,13 @@ void ConfigParser::parseServerDirective(const std::string& line, ServerConfig& c
 		}
 		if (listen.port <= 0)
 			throw std::runtime_error("Invalid port");
+		std::string option;
+		while (iss >> option) {
+			if (option.back() == ';')
+				option.pop_back();
+			if (!option.empty())
+				parseListenOption(option, listen);
+		}
 		config.listens.push_back(listen);
 	} else if (directive == "server_name") {
 		iss >> config.serverName;
@@ -138,6 +148,19 @@ void ConfigParser::parseServerDirective(const std::string& line, ServerConfig& c
 		if (temp <= 0)
 			throw std::runtime_error("Invalid body size");
 		config.clientMaxBodySize = temp;
+	} else if (directive == "max_connections") {
+		std::string value;
+		iss >> value;
+		if (!value.empty() && value.back() == ';')
+			value.pop_back();
+		config.maxConnections = parsePositiveInt(value, "max_connections");
+	} else if (directive == "tcp_nopush" || directive == "tcp_nodelay") {
+		std::string value;
+		iss >> value;
+		if (!value.empty() && value.back() == ';')
+			value.pop_back();
+		bool &option = directive == "tcp_nopush" ? config.tcpNopush : config.tcpNodelay;
+		option = (value == "on");
 	} else if (directive == "error_page") {
 		int code;
 		std::string path;
@@ -145,6 +168,135 @@ void ConfigParser::parseServerDirective(const std::string& line, ServerConfig& c
 		if (!path.empty() && path.back() == ';')
 			path.pop_back();
 		config.errorPages[code] = path;
+	} else {
+		throw std::runtime_error("Unknown server directive: " + directive);
+	}
+}
+
+// listen 8080 backlog=1024 deferred fastopen=256 rcvbuf=65536 sndbuf=65536;
+void ConfigParser::parseListenOption(const std::string& option, ListenConfig& listen) {
+	size_t eq = option.find('=');
+	std::string name = option.substr(0, eq);
+	std::string value = eq == std::string::npos ? "" : option.substr(eq + 1);
+
+	if (name == "deferred" && eq == std::string::npos)
+		listen.deferAccept = DEFAULT_DEFER_ACCEPT_SECS;
+	else if (name == "backlog")
+		listen.backlog = parsePositiveInt(value, "listen backlog");
+	else if (name == "fastopen")
+		listen.fastOpen = parsePositiveInt(value, "listen fastopen");
+	else if (name == "rcvbuf")
+		listen.rcvBuf = parsePositiveInt(value, "listen rcvbuf");
+	else if (name == "sndbuf")
+		listen.sndBuf = parsePositiveInt(value, "listen sndbuf");
+	else
+		throw std::runtime_error("Unknown listen option: " + option);
+	listen.hasOptions = true;
+}
+
+int ConfigParser::parsePositiveInt(const std::string& value, const std::string& directive) {
+	int result;
+	try {
+		result = std::stoi(value);
+	} catch (...) {
+		throw std::runtime_error("Invalid " + directive + ": " + value);
+	}
+	if (result <= 0)
+		throw std::runtime_error("Invalid " + directive + ": " + value);
+	return result;
+}
+
+// A byte count with an optional k, m or g suffix
+size_t ConfigParser::parseSize(const std::string& value, const std::string& directive) {
+	size_t pos = 0;
+	unsigned long long result;
+	try {
+		result = std::stoull(value, &pos);
+	} catch (...) {
+		throw std::runtime_error("Invalid " + directive + ": " + value);
+	}
+	std::string suffix = value.substr(pos);
+	if (suffix == "k" || suffix == "K")
+		result <<= 10;
+	else if (suffix == "m" || suffix == "M")
+		result <<= 20;
+	else if (suffix == "g" || suffix == "G")
+		result <<= 30;
+	else if (!suffix.empty())
+		throw std::runtime_error("Invalid " + directive + ": " + value);
+	if (result == 0)
+		throw std::runtime_error("Invalid " + directive + ": " + value);
+	return result;
+}
+
+int ConfigParser::parseTimeout(const std::string& value) {
+	return parsePositiveInt(value, "timeout");
+}
+
+void ConfigParser::parseGlobalDirective(const std::string& line, GlobalConfig& config) {
+	std::istringstream iss(line);
+	std::string directive;
+	iss >> directive;
+
+	std::string value;
+	iss >> value;
+	if (!value.empty() && value.back() == ';')
+		value.pop_back();
+
+	if (directive == "worker_threads") {
+		if (value == "auto") {
+			config.workerThreads = std::max(1u, std::thread::hardware_concurrency());
+			return;
+		}
+		config.workerThreads = parsePositiveInt(value, "worker_threads");
+	} else if (directive == "worker_cpu_affinity") {
+		config.workerCpuAffinity = (value == "on");
+	} else if (directive == "edge_triggered") {
+		config.edgeTriggered = (value == "on");
+	} else if (directive == "client_header_timeout") {
+		config.clientHeaderTimeout = parseTimeout(value);
+	} else if (directive == "client_body_timeout") {
+		config.clientBodyTimeout = parseTimeout(value);
+	} else if (directive == "keepalive_timeout") {
+		config.keepaliveTimeout = parseTimeout(value);
+	} else if (directive == "send_timeout") {
+		config.sendTimeout = parseTimeout(value);
+	} else if (directive == "cgi_timeout") {
+		config.cgiTimeout = parseTimeout(value);
+	} else if (directive == "max_events") {
+		config.maxEvents = parsePositiveInt(value, "max_events");
+	} else if (directive == "accept_budget") {
+		config.acceptBudget = parsePositiveInt(value, "accept_budget");
+	} else if (directive == "client_pool_size") {
+		config.clientPoolSize = parsePositiveInt(value, "client_pool_size");
+	} else if (directive == "log_level") {
+		config.logLevel = Logger::parseLevel(value);
+		if (config.logLevel < 0)
+			throw std::runtime_error("Invalid log_level: " + value);
+	} else if (directive == "max_connections") {
+		config.maxConnections = parsePositiveInt(value, "max_connections");
+	} else if (directive == "evict_idle_keepalive") {
+		config.evictIdleKeepalive = (value == "on");
+	} else if (directive == "overload_threshold") {
+		config.overloadThresholdMs = parsePositiveInt(value, "overload_threshold");
+	} else if (directive == "overload_retry_after") {
+		config.overloadRetryAfter = parsePositiveInt(value, "overload_retry_after");
+	} else if (directive == "max_request_line") {
+		config.maxRequestLine = parsePositiveInt(value, "max_request_line");
+	} else if (directive == "max_header_line") {
+		config.maxHeaderLine = parsePositiveInt(value, "max_header_line");
+	} else if (directive == "max_header_size") {
+		config.maxHeaderSize = parsePositiveInt(value, "max_header_size");
+	} else if (directive == "max_connection_buffer") {
+		config.maxConnectionBuffer = parsePositiveInt(value, "max_connection_buffer");
+	} else if (directive == "max_buffer_memory") {
+		config.maxBufferMemory = parseSize(value, "max_buffer_memory");
+	} else if (directive == "event_backend") {
+		if (value != "epoll" && value != "uring")
+			throw std::runtime_error("Invalid event_backend: " + value);
+		config.eventBackend = value;
+	} else {
+		throw std::runtime_error("Unknown directive: " + directive);
 	}
 }
 
@@ -186,6 +338,7 @@ void ConfigParser::parseServerBlock(std::ifstream& file, ServerConfig& config) {
 }
 
 void ConfigParser::parseConfig(const std::string& configFile) {
+	_globalConfig = GlobalConfig();
 	_serverConfigs.clear();
 	std::ifstream file(configFile);
 
@@ -204,6 +357,8 @@ void ConfigParser::parseConfig(const std::string& configFile) {
 			ServerConfig config;
 			parseServerBlock(file, config);
 			_serverConfigs.push_back(config);
+		} else {
+			parseGlobalDirective(line, _globalConfig);
 		}
 	}
 
@@ -219,8 +374,12 @@ const std::vector<ServerConfig>& ConfigParser::getServerConfigs() const {
 	return _serverConfigs;
 }
 
-void ConfigParser::createServersAndIpPortsFromConfig(Program &program) {
-	std::map<std::string, IpPortPtr> ipPortMap;
+const GlobalConfig& ConfigParser::getGlobalConfig() const {
+	return _globalConfig;
+}
+
+void ConfigParser::createServersFromConfig(ConfigSnapshot &snapshot) {
+	AddrPortServersMap &ipPortMap = snapshot.addrPortServers;
 
 	for (const auto& config : _serverConfigs) {
 		auto server = std::make_shared<Server>(config);
@@ -242,23 +401,23 @@ void ConfigParser::createServersAndIpPortsFromConfig(Program &program) {
 		for (const auto& listen : listens) {
 			std::string addrPort = listen.getAddressPort();
 
-			if (ipPortMap.find(addrPort) == ipPortMap.end()) {
-				auto ipPort = std::make_shared<IpPort>(program);
-				ipPort->setAddrPort(addrPort);
-				ipPortMap[addrPort] = ipPort;
-				program.getAddrPortVec().push_back(ipPort);
-			}
-
-			ipPortMap[addrPort]->getServers().push_back(server);
+			ipPortMap[addrPort].push_back(server);
+			auto known = snapshot.listenConfigs.find(addrPort);
+			if (known == snapshot.listenConfigs.end())
+				snapshot.listenConfigs.emplace(addrPort, listen);
+			else if (listen.hasOptions && known->second.hasOptions)
+				throw std::runtime_error("Duplicate listen options for " + addrPort);
+			else if (listen.hasOptions)
+				known->second = listen;
 		}
-		program.getServers().push_back(server);
+		snapshot.servers.push_back(server);
 	}
 	if (ipPortMap.size() == 0)
 		throw std::runtime_error("IpPort not created");
 }
 
 void ConfigParser::fulfillDefaultErrorPages(ServerConfig& config) {
-	static const int codes[] = {400, 403, 404, 405, 408, 413, 415, 500, 501, 505};
+	static const int codes[] = {400, 403, 404, 405, 408, 413, 414, 415, 431, 500, 501, 503, 504, 505};
 	for (int code : codes) {
 		if (config.errorPages.find(code) == config.errorPages.end()) {
 			config.errorPages[code] = DEFAULT_ERROR_DIR + std::to_string(code) + ".html";
@@ -0,0 +1,124 @@
+#include "EpollBackend.hpp"
+
+void	EpollBackend::control(int op, int fd, uint32_t events, uint64_t token)
+{
+	epoll_event	ev;
+
+	ev.events = events & ~EVENT_COMPLETION_MASK;
+	ev.data.u64 = token;
+	if (epoll_ctl(_epollFd, op, fd, &ev) == -1)
+		THROW_ERRNO("epoll_ctl");
+}
+
+void	EpollBackend::dropPending(int fd)
+{
+	if (fd >= 0 && static_cast<size_t>(fd) < _pending.size())
+		_pending[fd].dirty = false;
+}
+
+// A new registration is applied at once: it may reuse the number of an fd
+// whose change is still queued, which must not leak onto it.
+void	EpollBackend::add(int fd, uint32_t events, uint64_t token)
+{
+	dropPending(fd);
+	control(EPOLL_CTL_ADD, fd, events, token);
+}
+
+void	EpollBackend::modify(int fd, uint32_t events, uint64_t token)
+{
+	if (fd < 0)
+		THROW("Negative fd in EpollBackend");
+	if (static_cast<size_t>(fd) >= _pending.size())
+		_pending.resize(fd + 1);
+	PendingInterest	&pending = _pending[fd];
+	if (!pending.dirty)
+		_dirtyFds.push_back(fd);
+	pending.events = events;
+	pending.token = token;
+	pending.dirty = true;
+}
+
+void	EpollBackend::remove(int fd)
+{
+	dropPending(fd);
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, 0);
+}
+
+// The kernel drops closed fds from the interest list on its own, as long
+// as no forked child still holds a copy (which is why pipes use remove).
+void	EpollBackend::release(int fd)
+{
+	dropPending(fd);
+}
+
+// The owner is unknown here, so a failed change is only logged; the fd
+// was closed under us and its owner is already being torn down.
+void	EpollBackend::flush()
+{
+	for (int fd : _dirtyFds)
+	{
+		PendingInterest	&pending = _pending[fd];
+		if (!pending.dirty)
+			continue;
+		pending.dirty = false;
+		try
+		{
+			control(EPOLL_CTL_MOD, fd, pending.events, pending.token);
+		}
+		catch (std::exception &e)
+		{
+			LOG_WARN("Dropped interest change for fd ", fd, ": ", e.what());
+		}
+	}
+	_dirtyFds.clear();
+}
+
+int	EpollBackend::wait(std::vector<epoll_event> &events, int timeoutMs)
+{
+	flush();
+	int	nbrEvents = epoll_wait(_epollFd, events.data(), events.size(), timeoutMs);
+
+	if (nbrEvents == -1)
+	{
+		if (errno == EINTR)
+			return 0;
+		THROW_ERRNO("epoll_wait");
+	}
+	return nbrEvents;
+}
+
+bool	EpollBackend::isCompletionBased()
+{
+	return false;
+}
+
+void	EpollBackend::send(int fd, const char *data, size_t length, const FileChunk *chunk)
+{
+	(void)fd;
+	(void)data;
+	(void)length;
+	(void)chunk;
+	THROW("EpollBackend only reports readiness");
+}
+
+std::vector<Completion>	&EpollBackend::getCompletions()
+{
+	return _completions;
+}
+
+// Constructors + Destructor
+
+EpollBackend::EpollBackend()
+	: _epollFd{-1}
+{
+	_epollFd = epoll_create(DEFAULT_EPOLL_SIZE);
+	if (_epollFd == -1)
+		THROW_ERRNO("epoll_create");
+	utils::makeFdNoninheritable(_epollFd);
+}
+
+EpollBackend::~EpollBackend()
+{
+	if (_epollFd != -1)
+		close(_epollFd);
+}
@@ -0,0 +1,189 @@
+#include "HttpRequestParser.hpp"
+#include "Scan.hpp"
+
+#include <cstring>
+#include <charconv>
+
+static bool	isOws(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static std::string_view	slice(std::string_view buffer, Span span)
+{
+	return buffer.substr(span.offset, span.length);
+}
+
+// Consumes every complete line past _lineStart. Returns true once the
+// empty line ending the head has been seen; getHeadEnd() then points past it.
+bool	HttpRequestParser::feed(std::string_view buffer)
+{
+	HttpError	error;
+
+	while (_state != ParseState::DONE && _state != ParseState::FAILED && _lineStart < buffer.size())
+	{
+		const char	*newline = static_cast<const char*>(
+			memchr(buffer.data() + _lineStart, '\n', buffer.size() - _lineStart));
+		if (!newline)
+		{
+			error = checkLimits(buffer.size() - _lineStart, buffer.size());
+			break;
+		}
+		size_t	next = newline - buffer.data() + 1;
+		if ((error = checkLimits(next - _lineStart, next)))
+			break;
+		size_t	lineEnd = next - 1;
+		if (lineEnd > _lineStart && buffer[lineEnd - 1] == '\r')
+			--lineEnd;
+
+		if (lineEnd == _lineStart)
+		{
+			// Empty lines before the request line are tolerated (RFC 9112 2.2)
+			if (_state == ParseState::HEADERS)
+			{
+				_state = ParseState::DONE;
+				_headEnd = next;
+			}
+		}
+		else if (_state == ParseState::REQUEST_LINE)
+			error = parseRequestLine(buffer, lineEnd);
+		else
+			error = parseHeaderLine(buffer, lineEnd);
+		if (error)
+			break;
+		_lineStart = next;
+	}
+	if (error)
+	{
+		_state = ParseState::FAILED;
+		_error = error;
+	}
+	return _state == ParseState::DONE;
+}
+
+// Also called on a partial line, so a peer that never sends the newline
+// is cut off once it passes the limit rather than when it stops.
+HttpError	HttpRequestParser::checkLimits(size_t lineLength, size_t headLength)
+{
+	if (_state == ParseState::REQUEST_LINE && lineLength > _limits.requestLine)
+		return HTTP_ERROR(414, "Request line too long");
+	if (_state == ParseState::HEADERS && lineLength > _limits.headerLine)
+		return HTTP_ERROR(431, "Header field too large");
+	if (headLength > _limits.headerSize)
+		return HTTP_ERROR(431, "Request head too large");
+	return {};
+}
+
+HttpError	HttpRequestParser::parseRequestLine(std::string_view buffer, size_t lineEnd)
+{
+	std::string_view	line = buffer.substr(_lineStart, lineEnd - _lineStart);
+	size_t				firstSpace = line.find(' ');
+	size_t				secondSpace = line.find(' ', firstSpace + 1);
+
+	if (firstSpace == 0 || firstSpace == std::string_view::npos
+		|| secondSpace == std::string_view::npos || secondSpace == firstSpace + 1
+		|| scan::tokenLength(line.data(), firstSpace) != firstSpace)
+		return HTTP_ERROR(400, "Malformed request line");
+	_method = tokens::lookupMethod(line.substr(0, firstSpace));
+	_target = {_lineStart + firstSpace + 1, secondSpace - firstSpace - 1};
+	_version = {_lineStart + secondSpace + 1, line.size() - secondSpace - 1};
+	_state = ParseState::HEADERS;
+	return {};
+}
+
+HttpError	HttpRequestParser::parseHeaderLine(std::string_view buffer, size_t lineEnd)
+{
+	std::string_view	line = buffer.substr(_lineStart, lineEnd - _lineStart);
+	size_t				colon = scan::tokenLength(line.data(), line.size());
+
+	// field-name is a token followed directly by ':' (RFC 9112 5.1)
+	if (colon == 0 || colon == line.size() || line[colon] != ':')
+		return HTTP_ERROR(400, "Malformed header field");
+	std::string_view	name = line.substr(0, colon);
+	size_t				valueStart = colon + 1;
+	size_t				valueEnd = line.size();
+	while (valueStart < valueEnd && isOws(line[valueStart]))
+		++valueStart;
+	while (valueEnd > valueStart && isOws(line[valueEnd - 1]))
+		--valueEnd;
+	Span	value = {_lineStart + valueStart, valueEnd - valueStart};
+
+	switch (tokens::lookupHeader(name))
+	{
+		case HeaderId::HOST:
+			_host = value;
+			break;
+		case HeaderId::CONTENT_TYPE:
+			_contentType = value;
+			break;
+		case HeaderId::TRANSFER_ENCODING:
+			_transferEncoding = value;
+			break;
+		case HeaderId::CONNECTION:
+			_connection = value;
+			break;
+		case HeaderId::EXPECT:
+			_expect = value;
+			break;
+		case HeaderId::CONTENT_LENGTH:
+		{
+			std::string_view	digits = slice(buffer, value);
+			auto				res = std::from_chars(digits.data(), digits.data() + digits.size(), _contentLength);
+			if (digits.empty() || res.ec != std::errc() || res.ptr != digits.data() + digits.size())
+				return HTTP_ERROR(400, "Invalid body size");
+			break;
+		}
+		case HeaderId::UNKNOWN:
+			break;
+	}
+	return {};
+}
+
+RequestHead	HttpRequestParser::getHead(std::string_view buffer) const
+{
+	RequestHead	head;
+
+	head.method = _method;
+	head.target = slice(buffer, _target);
+	head.version = slice(buffer, _version);
+	head.host = slice(buffer, _host);
+	head.contentType = slice(buffer, _contentType);
+	head.transferEncoding = slice(buffer, _transferEncoding);
+	head.connection = slice(buffer, _connection);
+	head.expect = slice(buffer, _expect);
+	head.contentLength = _contentLength;
+	return head;
+}
+
+size_t	HttpRequestParser::getHeadEnd() const
+{
+	return _headEnd;
+}
+
+HttpError	HttpRequestParser::getError() const
+{
+	return _error;
+}
+
+void	HttpRequestParser::reset()
+{
+	HeadLimits	limits = _limits;
+
+	*this = HttpRequestParser();
+	_limits = limits;
+}
+
+void	HttpRequestParser::setLimits(const HeadLimits &limits)
+{
+	_limits = limits;
+}
+
+// Constructors + Destructor
+
+HttpRequestParser::HttpRequestParser()
+	: _state{ParseState::REQUEST_LINE}
+	, _lineStart{0}
+	, _headEnd{0}
+	, _method{HttpMethod::UNKNOWN}
+	, _contentLength{0}
+{}
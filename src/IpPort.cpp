@@ -1,8 +1,13 @@
 #include "IpPort.hpp"
 #include "Cgi.hpp"
 #include "PostRequestHandler.hpp"
+#include "UriPath.hpp"
 
-void	IpPort::OpenSocket(addrinfo &hints, addrinfo **_servInfo)
+// Every listener sets SO_REUSEPORT, whatever the worker count: a binary
+// started by an upgrade binds its own sockets next to the inherited ones
+// when it runs more workers. With inheritedOnly, nothing new is bound and
+// _sockFd stays -1 when no inherited socket is left for the address.
+void	IpPort::OpenSocket(addrinfo &hints, addrinfo **_servInfo, bool inheritedOnly)
 {
 	int	err;
 
@@ -14,6 +19,18 @@ void	IpPort::OpenSocket(addrinfo &hints, addrinfo **_servInfo)
 	if (err != 0)
 		THROW(gai_strerror(err));
 
+	// Already bound and listening in the process we took over from
+	_sockFd = _worker.getProgram().takeInheritedSocket((*_servInfo)->ai_addr, (*_servInfo)->ai_addrlen);
+	if (_sockFd != -1)
+	{
+		utils::makeFdNonBlocking(_sockFd);
+		applyListenOptions();
+		LOG_INFO("Adopted inherited listener for ", _addrPort);
+		return;
+	}
+	if (inheritedOnly)
+		return;
+
 	_sockFd = socket((*_servInfo)->ai_family, (*_servInfo)->ai_socktype, (*_servInfo)->ai_protocol);
 	if (_sockFd == -1)
 		THROW_ERRNO("socket");
@@ -24,13 +41,35 @@ void	IpPort::OpenSocket(addrinfo &hints, addrinfo **_servInfo)
 	err = setsockopt(_sockFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 	if (err == -1)
 		THROW_ERRNO("setsockopt(SO_REUSEADDR)");
+	err = setsockopt(_sockFd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+	if (err == -1)
+		THROW_ERRNO("setsockopt(SO_REUSEPORT)");
 
 	err = bind(_sockFd, (*_servInfo)->ai_addr, (*_servInfo)->ai_addrlen);
 	if (err == -1)
 		THROW_ERRNO("bind");
 
-	err = listen(_sockFd, QUEUE_SIZE);
-	if (err == -1)
+	applyListenOptions();
+}
+
+// Also used on reload and on inherited sockets: listen() on a listening
+// socket only updates its backlog. Zero buffer sizes keep the kernel's
+// defaults; deferred and fastopen are reset when dropped from the config.
+void	IpPort::applyListenOptions()
+{
+	if (_listenConfig.rcvBuf > 0
+		&& setsockopt(_sockFd, SOL_SOCKET, SO_RCVBUF, &_listenConfig.rcvBuf, sizeof(int)) == -1)
+		THROW_ERRNO("setsockopt(SO_RCVBUF)");
+	if (_listenConfig.sndBuf > 0
+		&& setsockopt(_sockFd, SOL_SOCKET, SO_SNDBUF, &_listenConfig.sndBuf, sizeof(int)) == -1)
+		THROW_ERRNO("setsockopt(SO_SNDBUF)");
+	if (setsockopt(_sockFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &_listenConfig.deferAccept, sizeof(int)) == -1)
+		THROW_ERRNO("setsockopt(TCP_DEFER_ACCEPT)");
+	// Not fatal: TCP Fast Open may be disabled system-wide
+	if (setsockopt(_sockFd, IPPROTO_TCP, TCP_FASTOPEN, &_listenConfig.fastOpen, sizeof(int)) == -1
+		&& _listenConfig.fastOpen > 0)
+		LOG_WARN("TCP_FASTOPEN unavailable on ", _addrPort, ": ", strerror(errno));
+	if (listen(_sockFd, _listenConfig.backlog) == -1)
 		THROW_ERRNO("listen");
 }
 
@@ -51,10 +90,14 @@ std::string	IpPort::getStatusText(int statusCode)
 		case 405: return "Method Not Allowed";
 		case 408: return "Request Timeout";
 		case 413: return "Payload Too Large";
+		case 414: return "URI Too Long";
 		case 415: return "Unsupported Media Type";
+		case 431: return "Request Header Fields Too Large";
 
 		case 500: return "Internal Server Error";
 		case 501: return "Not Implemented";
+		case 503: return "Service Unavailable";
+		case 504: return "Gateway Timeout";
 		case 505: return "HTTP Version Not Supported";
 		default: return "Unknown";
 	}
@@ -66,27 +109,43 @@ void	IpPort::handleEpollEvent(epoll_event &ev, int eventFd)
 	{
 		acceptConnection();
 	}
-	else if (ev.events & EPOLLIN)
+	else if ((ev.events & (EPOLLHUP | EPOLLERR)) && !(ev.events & EPOLLIN))
+	{
+		closeConnection(eventFd);
+	}
+	else if (ev.events & (EPOLLIN | EPOLLOUT))
 	{
-		ClientPtr	client = (*_clientsMap.find(eventFd)).second;
+		ClientPtr	*clientSlot = _clientsTable.find(eventFd);
+		if (!clientSlot)
+			return;
+		ClientPtr	&client = *clientSlot;
 		try
 		{
+			if ((ev.events & EPOLLOUT) && !client->flushQueuedResponses())
+				return closeConnection(eventFd);
+			if (client->isInputClosed())
+				return closeOnceFlushed(client);
+			if (!(ev.events & EPOLLIN))
+				return;
 			if (client->getState() == ClientState::READING_REQUEST)
 			{
 				if (!client->readRequest())
-					return closeConnection(eventFd);
-				parseRequest(client);
+					return closeOnceFlushed(client);
+				processRequests(client);
 			}
 			else if (client->getState() == ClientState::GETTING_BODY)
 			{
 				if (!client->readRequest())
-					return closeConnection(eventFd);
+					return closeOnceFlushed(client);
 				client->getPostRequestHandler().handlePostRequest(client);
+				client->chargeBuffers();
+				if (client->isInputClosed())
+					closeOnceFlushed(client);
 			}
 		}
 		catch (std::bad_alloc &e)
 		{
-			std::cerr << "ERROR: Infficient memory" << std::endl;
+			LOG_ERROR("Insufficient memory");
 			closeConnection(eventFd);
 		}
 		catch (HttpException &e)
@@ -100,10 +159,6 @@ void	IpPort::handleEpollEvent(epoll_event &ev, int eventFd)
 				closeConnection(eventFd);
 			}
 		}
-		catch (ChildFailedException& e)
-		{
-			throw;
-		}
 		catch (std::exception &e)
 		{
 			closeConnection(eventFd);
@@ -111,162 +166,231 @@ void	IpPort::handleEpollEvent(epoll_event &ev, int eventFd)
 	}
 }
 
-void	IpPort::parseRequest(ClientPtr &client)
+// Completion mode: the multishot accept hands over connections it already
+// took, so one over the limit is closed on the spot rather than left in the
+// backlog. The socket completions of clients this listener reads for are
+// theirs to handle.
+void	IpPort::handleCompletion(Completion &completion, int eventFd)
 {
-	parseHeaders(client);
-	assignServerToClient(client);
-
-	client->getOwnerServer()->areHeadersValid(client);
-
-	if (client->getState() == ClientState::SENDING_RESPONSE)
+	if (eventFd != _sockFd)
+	{
+		if (ClientPtr *client = _clientsTable.find(eventFd))
+			(*client)->handleCompletion(completion, eventFd);
 		return;
-
-	if (client->getHttpMethod() == "GET")
+	}
+	if (completion.result < 0)
+	{
+		if (completion.result == -EMFILE || completion.result == -ENFILE)
+			_worker.pauseListener(*this);
+		if (completion.result != -EINTR && completion.result != -ECONNABORTED)
+			LOG_WARN("Failed to accept new connection: ", strerror(-completion.result));
+		return;
+	}
+	int	clientFd = completion.result;
+	if (!reserveSlot() && (!evictIdleConnection() || !reserveSlot()))
 	{
-		handleGetRequest(client);
+		close(clientFd);
+		_worker.getProgram().getConnectionStats().rejected.fetch_add(1, std::memory_order_relaxed);
+		_stats->rejected.fetch_add(1, std::memory_order_relaxed);
+		_worker.pauseListener(*this);
+		return;
 	}
-	else if (client->getHttpMethod() == "POST")
+	_worker.getProgram().getConnectionStats().accepted.fetch_add(1, std::memory_order_relaxed);
+	_stats->accepted.fetch_add(1, std::memory_order_relaxed);
+	registerConnection(clientFd);
+}
+
+// Answers the requests already in the buffer. Consecutive small keep-alive
+// responses, up to PIPELINE_MAX_QUEUED, are held back and leave in one write.
+void	IpPort::processRequests(ClientPtr &client)
+{
+	parseRequest(client);
+	while (client->canQueueResponse())
 	{
-		client->getPostRequestHandler().handlePostRequest(client);
+		client->queueResponse();
+		parseRequest(client);
 	}
-	else if (client->getHttpMethod() == "DELETE")
+	client->chargeBuffers();
+	if (client->getState() != ClientState::SENDING_RESPONSE && !client->flushQueuedResponses())
 	{
-		handleDeleteRequest(client);
+		int	fd = client->getFd();
+		return closeConnection(fd);
 	}
+	if (client->isInputClosed())
+		closeOnceFlushed(client);
 }
 
-void	IpPort::parseHeaders(ClientPtr &client)
+// A peer that stopped sending mid-request still gets the responses held
+// for it: the close waits for the EPOLLOUT that empties the queue.
+void	IpPort::closeOnceFlushed(ClientPtr &client)
 {
-	size_t	headersEnd = client->getBuffer().find("\r\n\r\n");
-	if (headersEnd == std::string::npos)
+	ClientState	state = client->getState();
+	int			fd = client->getFd();
+
+	if (state != ClientState::READING_REQUEST && state != ClientState::GETTING_BODY)
 		return;
+	if (client->hasQueuedResponses())
+		return client->updateEpollInterest();
+	closeConnection(fd);
+}
 
-	client->resetRequestData();
-	std::string			headers = client->getBuffer().substr(0, headersEnd);
-	std::istringstream	iss(headers);
-	std::string			line;
+void	IpPort::parseRequest(ClientPtr &client)
+{
+	HttpError	error;
 
-	std::getline(iss, line);
-	size_t firstSpace = line.find(' ');
-	size_t secondSpace = line.find(' ', firstSpace + 1);
-	client->setHttpMethod(line.substr(0, firstSpace));
+	if (!parseHeaders(client, error))
+	{
+		if (error)
+			rejectRequest(client, error);
+		return;
+	}
+	// Only whole heads are shed, so a request is never cut off mid-read
+	if (_worker.isOverloaded())
+		return shedRequest(client);
+	assignServerToClient(client);
+	if (!error)
+		error = client->getOwnerServer()->validateRequest(client);
+	if (error)
+		return rejectRequest(client, error);
 
-	std::string	pathAndQuery = line.substr(firstSpace + 1, secondSpace - firstSpace - 1);
-	parseQuery(client, pathAndQuery);
-	client->setHttpVersion(line.substr(secondSpace + 1));
-	if (client->getHttpVersion().back() == '\r') client->getHttpVersion().pop_back();
+	if (client->getState() == ClientState::SENDING_RESPONSE)
+		return;
+	sendContinue(client);
 
-	while (std::getline(iss, line))
+	switch (client->getHttpMethod())
 	{
-		if (!line.empty() && line.back() == '\r')
-			line.pop_back();
-		size_t colon = line.find(':');
-		if (colon == std::string::npos)
-			continue ;
-		std::string	name = line.substr(0, colon);
-		std::string	value = line.substr(colon + 1);
-
-		while (!value.empty() && isspace(value.front()))
-			value.erase(0, 1);
-		while (!value.empty() && isspace(value.back()))
-			value.pop_back();
-
-		if (name == "Host")
-		{
-			client->setHostHeader(value);
-		}
-		else if (name == "Content-Length")
-		{
-			try {
-				auto temp = std::stoll(value);
-				if (temp < 0)
-					THROW_HTTP(400, "Invalid body size");
-				client->setContentLen(temp);
-			}
-			catch(std::exception& e) {
-				THROW_HTTP(400, "Invalid body size");
-			}
-		}
-		else if (name == "Content-Type")
-		{
-			client->setContentType(value);
-			if (value.find(CONTENT_TYPE_MULTIPART) != std::string::npos)
-			{
-				size_t bpos = value.find("boundary=");
-				if (bpos != std::string::npos)
-				{
-					size_t valpos = bpos + strlen("boundary=");
-					client->setMultipartBoundary(value.substr(valpos));
-				}
-			}
-		}
-		else if (name == "Transfer-Encoding")
-		{
-			if (value.find("chunked") != std::string::npos)
-				client->setChunked(true);
-		}
-		else if (name == "Connection")
-		{
-			if (value.find("keep-alive") != std::string::npos)
-				client->setKeepAlive(true);
-		}
+		case HttpMethod::GET:
+			error = handleGetRequest(client);
+			break;
+		case HttpMethod::POST:
+			client->getPostRequestHandler().handlePostRequest(client);
+			break;
+		case HttpMethod::DELETE:
+			error = handleDeleteRequest(client);
+			break;
+		case HttpMethod::UNKNOWN:
+			break;
 	}
-
-	client->getBuffer().erase(0, headersEnd + 4);
+	if (error)
+		rejectRequest(client, error);
 }
 
-void	IpPort::parseQuery(ClientPtr &client, const std::string &pathAndQuery)
+// Picks up where the previous read left off; fields are copied out of the
+// buffer into the client's reused strings only once the head is complete.
+// Returns false while the head is incomplete or when it is malformed; a
+// head that parsed but names a bad path returns true, both with error set.
+bool	IpPort::parseHeaders(ClientPtr &client, HttpError &error)
 {
-	size_t	q = pathAndQuery.find_last_of('?');
-	std::string	query = pathAndQuery.substr(q + 1);
-	client->setHttpPath(pathAndQuery);
+	ReadBuffer	&buffer = client->getBuffer();
 
-	if (query == "_method=DELETE")
+	if (!client->getParser().feed(buffer.view()))
 	{
-		client->setQuery(query);
-		client->setHttpMethod("DELETE");
-		client->getHttpPath().erase(q);
+		error = client->getParser().getError();
+		return false;
 	}
-	else if (query.find("_download_file=") != std::string::npos)
+
+	RequestHead	head = client->getParser().getHead(buffer.view());
+	size_t		headEnd = client->getParser().getHeadEnd();
+
+	client->resetRequestData();
+	client->setHttpMethod(head.method);
+	error = parseQuery(client, head.target);
+	client->getHttpVersion().assign(head.version);
+	client->getHostHeader().assign(head.host);
+	client->setContentLen(head.contentLength);
+	client->getContentType().assign(head.contentType);
+	client->getMultipartBoundary().clear();
+	if (head.contentType.find(CONTENT_TYPE_MULTIPART) != std::string_view::npos)
 	{
-		client->setQuery(query);
-		client->getHttpPath().erase(q);
+		size_t	bpos = head.contentType.find("boundary=");
+		if (bpos != std::string_view::npos)
+			client->getMultipartBoundary().assign(head.contentType.substr(bpos + strlen("boundary=")));
 	}
+	if (head.transferEncoding.find("chunked") != std::string_view::npos)
+		client->setChunked(true);
+	if (head.connection.find("keep-alive") != std::string_view::npos)
+		client->setKeepAlive(true);
+	// Other expectations are ignored, which RFC 9110 10.1.1 allows
+	if (tokens::equalsIgnoreCase(head.expect, "100-continue"))
+		client->setExpectContinue(true);
+
+	buffer.consume(headEnd);
+	return true;
+}
+
+// The path is canonicalized here, once, and everything after it (location
+// matching, file lookup, CGI's REQUEST_URI) works on that form.
+HttpError	IpPort::parseQuery(ClientPtr &client, std::string_view pathAndQuery)
+{
+	size_t				q = pathAndQuery.find('?');
+	std::string_view	query = q == std::string_view::npos ? std::string_view() : pathAndQuery.substr(q + 1);
+
+	client->getQuery().assign(query);
+	if (query == "_method=DELETE")
+		client->setHttpMethod(HttpMethod::DELETE);
+	return uri::normalizePath(pathAndQuery.substr(0, q), client->getHttpPath());
+}
+
+// A client that sent Expect: 100-continue holds its body back until it is
+// told to go on, so a request refused on its headers never costs the body.
+// The interim response queues behind any held pipelined responses and is
+// skipped when body bytes have arrived anyway.
+void	IpPort::sendContinue(ClientPtr &client)
+{
+	if (!client->isExpectingContinue() || !client->getBuffer().empty()
+		|| (client->getContentLen() == 0 && !client->isChunked()))
+		return;
+	client->appendResponse(CONTINUE_RESPONSE);
+}
+
+// The error page goes out as the last response on the connection, the same
+// as for a thrown HttpException.
+void	IpPort::rejectRequest(ClientPtr &client, const HttpError &error)
+{
+	LOG_DEBUG("Rejected request: ", error.message);
+	client->resetRequestData();
+	client->getBuffer().clear();
+	generateResponse(client, "", error.statusCode);
+}
+
+// Load shedding: the request isn't routed and its body isn't read, it gets
+// the worker's prebuilt 503 and the connection is closed once that is sent.
+void	IpPort::shedRequest(ClientPtr &client)
+{
+	client->resetRequestData();
+	client->getBuffer().clear();
+	_worker.getProgram().getConnectionStats().shed.fetch_add(1, std::memory_order_relaxed);
+	_stats->shed.fetch_add(1, std::memory_order_relaxed);
+	client->setState(ClientState::SENDING_RESPONSE);
+	utils::changeEpollHandler(_handlersTable, client->getFd(), client.get());
+	client->appendResponse(_worker.getOverloadResponse());
 }
 
-void IpPort::handleGetRequest(ClientPtr &client)
+HttpError	IpPort::handleGetRequest(ClientPtr &client)
 {
 
 	if (client->getFileType() == FileType::CGI_SCRIPT)
 	{
 		if (!client->getCgi().init())
-			THROW_HTTP(500, "Failed to start CGI process");
+			return HTTP_ERROR(500, "Failed to start CGI process");
 
-		int cgiIn = client->getCgi().getStdinFd();
-		if (cgiIn != -1)
-		{
-			epoll_ctl(_epollFd, EPOLL_CTL_DEL, cgiIn, 0);
-			_handlersMap.erase(cgiIn);
-			close(cgiIn);
-		}
-		return;
+		client->getCgi().closeStdin();
+		return {};
 	}
 	generateResponse(client, client->getResolvedPath(), 200);
+	return {};
 }
 
-void	IpPort::handleDeleteRequest(ClientPtr &client)
+HttpError	IpPort::handleDeleteRequest(ClientPtr &client)
 {
-	if (std::remove(client->getResolvedPath().c_str()) == 0)
-	{
-		std::string dirPath = client->getHttpPath().substr(0, client->getHttpPath().find_last_of("/"));
-		std::string	port = _addrPort.substr(_addrPort.find(":") + 1);
-		client->setRedirectedUrl(LOCALHOST_URL + port + dirPath + "/");
-		generateResponse(client, "", 303);
-	}
-	else
-	{
-		THROW_HTTP(500, "Failed to delete file");
-	}
+	if (std::remove(client->getResolvedPath().c_str()) != 0)
+		return HTTP_ERROR(500, "Failed to delete file");
+
+	std::string dirPath = client->getHttpPath().substr(0, client->getHttpPath().find_last_of("/"));
+	std::string	port = _addrPort.substr(_addrPort.find(":") + 1);
+	client->setRedirectedUrl(LOCALHOST_URL + port + dirPath + "/");
+	generateResponse(client, "", 303);
+	return {};
 }
 
 void	IpPort::generateResponse(ClientPtr &client, std::string filePath, int statusCode)
@@ -290,7 +414,7 @@ void	IpPort::generateResponse(ClientPtr &client, std::string filePath, int statu
 		}
 		else
 		{
-			std::cout << filePath << std::endl;
+			LOG_DEBUG("Serving ", filePath);
 			client->openFile(filePath);
 			if (client->getFileFd() < 0)
 				success = false;
@@ -311,10 +435,10 @@ void	IpPort::generateResponse(ClientPtr &client, std::string filePath, int statu
 	if (!listingBuffer.empty())
 		response += listingBuffer;
 
-	std::cout << "HTTP code for client: " << statusCode << std::endl;
+	LOG_DEBUG("HTTP code for client: ", statusCode);
 	client->setState(ClientState::SENDING_RESPONSE);
-	utils::changeEpollHandler(_handlersMap, client->getFd(), client.get());
-	client->setResponseBuffer(std::move(response));
+	utils::changeEpollHandler(_handlersTable, client->getFd(), client.get());
+	client->appendResponse(response);
 }
 
 std::string	IpPort::formHeaders(ClientPtr &client, std::string &filePath, size_t contentLength, int code)
@@ -324,7 +448,7 @@ std::string	IpPort::formHeaders(ClientPtr &client, std::string &filePath, size_t
 
 	if (client->getFileType() == FileType::DIRECTORY)
 		contentType = "text/html";
-	else if (!filePath.empty() && client->getHttpMethod() == "GET" && code < 400)
+	else if (!filePath.empty() && client->getHttpMethod() == HttpMethod::GET && code < 400)
 	{
 		size_t		lastSlash = filePath.find_last_of("/\\");
 		std::string	fileName = (lastSlash == std::string::npos) ? filePath : filePath.substr(lastSlash + 1);
@@ -431,51 +555,165 @@ std::string	IpPort::getErrorPagePath(ClientPtr &client, int statusCode)
 		return DEFAULT_ERROR_DIR + std::to_string(statusCode) + ".html";
 }
 
+// Drains the accept queue up to the per-wakeup budget; the listening socket is
+// level-triggered, so whatever is left over is picked up on the next wakeup.
+// The default server of the address sets its limit: the Host header that
+// would pick another one isn't known before the connection is accepted.
+int	IpPort::getConnectionLimit()
+{
+	return _servers.empty() ? 0 : _servers.front()->getMaxConnections();
+}
+
+bool	IpPort::hasCapacity()
+{
+	return _worker.getProgram().getConnectionStats().hasCapacity(_worker.getProgram().getGlobalConfig().maxConnections)
+		&& _stats->hasCapacity(getConnectionLimit());
+}
+
+bool	IpPort::reserveSlot()
+{
+	ConnectionStats	&global = _worker.getProgram().getConnectionStats();
+
+	if (!global.tryAcquire(_worker.getProgram().getGlobalConfig().maxConnections))
+		return false;
+	if (!_stats->tryAcquire(getConnectionLimit()))
+	{
+		global.release();
+		return false;
+	}
+	return true;
+}
+
+void	IpPort::releaseSlot()
+{
+	_worker.getProgram().getConnectionStats().release();
+	_stats->release();
+}
+
+// Evicting only helps if it frees a slot under the limit that was hit: a
+// full listener needs one of its own connections closed, while the global
+// limit is served by whichever listener on this worker idles the longest.
+IpPort	*IpPort::findEvictionSource()
+{
+	if (!_worker.getProgram().getGlobalConfig().evictIdleKeepalive)
+		return nullptr;
+	if (!_stats->hasCapacity(getConnectionLimit()))
+		return _idleList.size() ? this : nullptr;
+	return _worker.findOldestIdleListener();
+}
+
+bool	IpPort::canEvictIdle()
+{
+	return findEvictionSource() != nullptr;
+}
+
+// Makes room for a new connection by closing the oldest idle keep-alive
+// connection that frees a slot under the exhausted limit.
+bool	IpPort::evictIdleConnection()
+{
+	IpPort	*owner = findEvictionSource();
+
+	if (!owner)
+		return false;
+	int	fd = owner->getIdleList().oldest();
+	_worker.getProgram().getConnectionStats().evicted.fetch_add(1, std::memory_order_relaxed);
+	owner->getStats().evicted.fetch_add(1, std::memory_order_relaxed);
+	owner->closeConnection(fd);
+	LOG_DEBUG("Evicted idle connection fd ", fd, " on ", owner->getAddrPort(), " for ", _addrPort);
+	return true;
+}
+
+// Admission control: a slot is reserved before each accept. At the limit
+// the oldest idle keep-alive connection may be closed to make room for a
+// pending one, otherwise the listener leaves the interest set and the
+// backlog absorbs new connections until the worker resumes it. EMFILE and
+// ENFILE pause it too, as a level-triggered listener would otherwise spin
+// on the pending queue.
 void	IpPort::acceptConnection()
 {
-	std::cout << "Accepting new connection..." << std::endl;
-	int					err;
-	epoll_event			newEv;
-	int					clientFd;
-	sockaddr_storage	clientAddr;
-	socklen_t			clientAddrLen = sizeof(clientAddr);
+	int	budget = _worker.getAcceptBudget();
 
-	try
+	for (int accepted = 0; accepted < budget; ++accepted)
 	{
-		clientFd = accept(_sockFd, (sockaddr *)&clientAddr, &clientAddrLen);
+		// Only the first accept is known to have a connection waiting; past
+		// it, stop and let the next readiness event decide
+		if (!reserveSlot() && (accepted > 0 || !evictIdleConnection() || !reserveSlot()))
+		{
+			if (accepted > 0)
+				return;
+			_worker.getProgram().getConnectionStats().rejected.fetch_add(1, std::memory_order_relaxed);
+			_stats->rejected.fetch_add(1, std::memory_order_relaxed);
+			_worker.pauseListener(*this);
+			return;
+		}
+		int	clientFd = accept4(_sockFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
 		if (clientFd == -1)
-			THROW_ERRNO("accept");
-		utils::makeFdNoninheritable(clientFd);
-		utils::makeFdNonBlocking(clientFd);
-		ClientPtr	newClient = std::make_shared<Client>(clientFd, *this);
-		_clientsMap.emplace(clientFd, newClient);
-		_handlersMap.emplace(clientFd, this);
-		newEv.events = EPOLLIN | EPOLLOUT;
-		newEv.data.fd = clientFd;
-		err = epoll_ctl(_epollFd, EPOLL_CTL_ADD, clientFd, &newEv);
-		if (err)
 		{
-			closeConnection(clientFd);
-			THROW_ERRNO("epoll_ctl");
+			releaseSlot();
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno == EMFILE || errno == ENFILE)
+				_worker.pauseListener(*this);
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				LOG_WARN("Failed to accept new connection: ", strerror(errno));
+			return;
 		}
+		_worker.getProgram().getConnectionStats().accepted.fetch_add(1, std::memory_order_relaxed);
+		_stats->accepted.fetch_add(1, std::memory_order_relaxed);
+		registerConnection(clientFd);
+	}
+}
+
+void	IpPort::registerConnection(int clientFd)
+{
+	bool	owned = false;
+
+	try
+	{
+		ClientPtr	newClient = _worker.getClientPool().acquire(clientFd, *this);
+		uint32_t	events = newClient->getEpollEvents();
+		owned = true;
+		_clientsTable.emplace(clientFd, std::move(newClient));
+		_handlersTable.emplace(clientFd, this);
+		_worker.getEventBackend().add(clientFd, events, _handlersTable.getToken(clientFd));
+		LOG_DEBUG("Accepted connection fd ", clientFd, " on ", _addrPort);
 	}
 	catch (const std::exception& e)
 	{
+		if (!owned)
+			close(clientFd);
+		// The slot is only given back on close once the client is in the table
+		if (!_clientsTable.find(clientFd))
+			releaseSlot();
 		closeConnection(clientFd);
-		std::cerr << "Failed to accept new connection:" << e.what() << std::endl;
+		LOG_WARN("Failed to accept new connection: ", e.what());
 	}
-	std::cout << "Connection was accepted" << std::endl;
 }
 
 void	IpPort::closeConnection(int &clientFd)
 {
-	std::cout << "Closing connection..." << std::endl;
-	if (clientFd != -1)
+	int	fd = clientFd;
+
+	if (fd != -1)
 	{
-		_handlersMap.erase(clientFd);
-		_clientsMap.erase(clientFd);
+		_worker.getEventBackend().release(fd);
+		_handlersTable.erase(fd);
+		if (ClientPtr *client = _clientsTable.find(fd))
+		{
+			releaseSlot();
+			(*client)->detach();
+			_worker.deferClose(std::move(*client));
+		}
+		_clientsTable.erase(fd);
 	}
-	std::cout << "Connection was closed" << std::endl;
+	LOG_DEBUG("Closed connection fd ", fd);
+}
+
+void	IpPort::closeSocket()
+{
+	if (_sockFd != -1)
+		close(_sockFd);
+	_sockFd = -1;
 }
 
 // Getters + Setters
@@ -485,14 +723,19 @@ int	IpPort::getSockFd()
 	return _sockFd;
 }
 
-FdClientMap&	IpPort::getClientsMap()
+Worker&	IpPort::getWorker()
+{
+	return _worker;
+}
+
+FdClientTable&	IpPort::getClientsTable()
 {
-	return _clientsMap;
+	return _clientsTable;
 }
 
-FdEpollOwnerMap&	IpPort::getHandlersMap()
+FdEpollOwnerTable&	IpPort::getHandlersTable()
 {
-	return _handlersMap;
+	return _handlersTable;
 }
 
 ServerDeq&	IpPort::getServers()
@@ -505,14 +748,35 @@ const std::string&	IpPort::getAddrPort()
 	return _addrPort;
 }
 
-int&	IpPort::getEpollFd()
+ConnectionStats	&IpPort::getStats()
 {
-	return _epollFd;
+	return *_stats;
+}
+
+IdleList	&IpPort::getIdleList()
+{
+	return _idleList;
+}
+
+bool	IpPort::isPaused()
+{
+	return _paused;
 }
 
 void	IpPort::setAddrPort(const std::string &addrPort)
 {
 	_addrPort = addrPort;
+	_stats = _worker.getProgram().getListenerStats(addrPort);
+}
+
+void	IpPort::setListenConfig(const ListenConfig &listenConfig)
+{
+	_listenConfig = listenConfig;
+}
+
+void	IpPort::setPaused(bool paused)
+{
+	_paused = paused;
 }
 
 void	IpPort::setSockFd(int fd)
@@ -524,13 +788,13 @@ void	IpPort::setSockFd(int fd)
 
 IpPort::~IpPort()
 {
-	if (_sockFd != -1)
-		close(_sockFd);
+	closeSocket();
 }
 
-IpPort::IpPort(Program &program)
-	: _clientsMap{program.getClientsMap()}
-	, _handlersMap{program.getHandlersMap()}
+IpPort::IpPort(Worker &worker)
+	: _worker{worker}
+	, _clientsTable{worker.getClientsTable()}
+	, _handlersTable{worker.getHandlersTable()}
 	, _sockFd{-1}
-	, _epollFd{program.getEpollFd()}
+	, _paused{false}
 {}
@@ -0,0 +1,169 @@
+#include "Logger.hpp"
+
+LogSlot				Logger::_slots[LOG_RING_SIZE];
+std::atomic<size_t>	Logger::_enqueuePos{0};
+size_t				Logger::_dequeuePos = 0;
+std::atomic<int>	Logger::_level{LOG_LEVEL_OFF};
+std::atomic<size_t>	Logger::_dropped{0};
+std::atomic<bool>	Logger::_running{false};
+std::thread			*Logger::_flusher = nullptr;
+pid_t				Logger::_ownerPid = -1;
+
+static const char	*levelTag(int level)
+{
+	switch (level)
+	{
+		case LOG_LEVEL_DEBUG: return "[DEBUG] ";
+		case LOG_LEVEL_INFO: return "[INFO] ";
+		case LOG_LEVEL_WARN: return "[WARN] ";
+		default: return "[ERROR] ";
+	}
+}
+
+static void	writeAll(int fd, std::string &batch)
+{
+	size_t	offset = 0;
+
+	while (offset < batch.size())
+	{
+		ssize_t	written = write(fd, batch.data() + offset, batch.size() - offset);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			break;
+		offset += written;
+	}
+	batch.clear();
+}
+
+LogSlot	*Logger::claim(size_t &pos)
+{
+	pos = _enqueuePos.load(std::memory_order_relaxed);
+	while (true)
+	{
+		LogSlot		*slot = &_slots[pos & (LOG_RING_SIZE - 1)];
+		size_t		sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t	diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+		if (diff == 0)
+		{
+			if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				return slot;
+		}
+		else if (diff < 0)
+		{
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		else
+			pos = _enqueuePos.load(std::memory_order_relaxed);
+	}
+}
+
+void	Logger::publish(LogSlot *slot, size_t pos)
+{
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void	Logger::append(LogSlot &slot, std::string_view text)
+{
+	size_t	room = LOG_RECORD_SIZE - slot.length;
+	size_t	count = std::min(room, text.size());
+
+	memcpy(slot.text + slot.length, text.data(), count);
+	slot.length += count;
+}
+
+// Single consumer: only the flusher thread drains the ring.
+size_t	Logger::drain()
+{
+	std::string	out;
+	std::string	err;
+	size_t		count = 0;
+
+	while (true)
+	{
+		LogSlot	*slot = &_slots[_dequeuePos & (LOG_RING_SIZE - 1)];
+		if (slot->sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+			break;
+		std::string	&batch = slot->level >= LOG_LEVEL_WARN ? err : out;
+		if (batch.size() + LOG_RECORD_SIZE + 16 > LOG_BATCH_SIZE)
+			writeAll(slot->level >= LOG_LEVEL_WARN ? STDERR_FILENO : STDOUT_FILENO, batch);
+		batch.append(levelTag(slot->level));
+		batch.append(slot->text, slot->length);
+		batch.push_back('\n');
+		slot->sequence.store(_dequeuePos + LOG_RING_SIZE, std::memory_order_release);
+		++_dequeuePos;
+		++count;
+	}
+	size_t	dropped = _dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped)
+		err.append("[WARN] logger dropped " + std::to_string(dropped) + " records\n");
+	writeAll(STDOUT_FILENO, out);
+	writeAll(STDERR_FILENO, err);
+	return count;
+}
+
+void	Logger::flusherLoop()
+{
+	while (_running.load(std::memory_order_acquire))
+	{
+		if (drain() == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+	}
+	drain();
+}
+
+void	Logger::start()
+{
+	if (_flusher)
+		return;
+	for (size_t i = 0; i < LOG_RING_SIZE; ++i)
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+	_enqueuePos.store(0, std::memory_order_relaxed);
+	_dequeuePos = 0;
+	_level.store(LOG_LEVEL_INFO, std::memory_order_release);
+	_running.store(true, std::memory_order_release);
+	_ownerPid = getpid();
+
+	// The flusher inherits a fully blocked mask so process-directed signals
+	// (SIGHUP for reload) are never delivered to it.
+	sigset_t	all;
+	sigset_t	previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	_flusher = new std::thread(&Logger::flusherLoop);
+	pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+// A forked child inherits the ring, whose pending records belong to the
+// parent, but not the flusher thread: it must leave both alone.
+void	Logger::stop()
+{
+	if (!_flusher || getpid() != _ownerPid)
+		return;
+	_running.store(false, std::memory_order_release);
+	_flusher->join();
+	delete _flusher;
+	_flusher = nullptr;
+}
+
+void	Logger::setLevel(int level)
+{
+	_level.store(level, std::memory_order_relaxed);
+}
+
+int	Logger::parseLevel(const std::string &name)
+{
+	if (name == "debug")
+		return LOG_LEVEL_DEBUG;
+	if (name == "info")
+		return LOG_LEVEL_INFO;
+	if (name == "warn")
+		return LOG_LEVEL_WARN;
+	if (name == "error")
+		return LOG_LEVEL_ERROR;
+	if (name == "off")
+		return LOG_LEVEL_OFF;
+	return -1;
+}
@@ -1,11 +1,15 @@
 #include "PostRequestHandler.hpp"
 #include "IpPort.hpp"
+#include "Scan.hpp"
 
 void	PostRequestHandler::handlePostRequest(ClientPtr &client)
 {
 	if (!_bodyProcessingInitialized)
 	{
 		_bodyProcessingInitialized = true;
+		// Held pipelined responses don't wait on the body; a send failure
+		// leaves them held and the next EPOLLOUT or EPOLLERR deals with it
+		client->flushQueuedResponses();
 		client->setState(ClientState::GETTING_BODY);
 		if (client->isChunked())
 		{
@@ -30,9 +34,13 @@ void	PostRequestHandler::handlePostRequest(ClientPtr &client)
 	{
 		if (client->getContentType().find(CONTENT_TYPE_MULTIPART) != std::string::npos)
 		{
-			isBodyFinished = getMultiPart(client);
-			if (isBodyFinished)
-				writeBodyPart(client);
+			if (!_multipartFinished)
+			{
+				_multipartFinished = getMultiPart(client);
+				if (_multipartFinished)
+					writeBodyPart(client);
+			}
+			isBodyFinished = _multipartFinished;
 		}
 		else if (client->getContentType().find(CONTENT_TYPE_APP_FORM) != std::string::npos)
 			THROW_HTTP(501, "No implemented for Post");
@@ -47,21 +55,39 @@ void	PostRequestHandler::handlePostRequest(ClientPtr &client)
 	std::string	port = addrPort.substr(addrPort.find(":") + 1);
 
 	client->setRedirectedUrl(LOCALHOST_URL + port + "/" + client->getHttpPath() + ".html");
-	_ipPort.generateResponse(client, "", 303);
+	client->getIpPort().generateResponse(client, "", 303);
 }
 
-void	PostRequestHandler::writeBodyPart(ClientPtr &client)
+// Decoded upload bytes go to disk every UPLOAD_FLUSH_SIZE, so the memory an
+// upload holds doesn't grow with the file. They are written next to the
+// target and only renamed over it once the part is complete.
+void	PostRequestHandler::flushUpload(ClientPtr &client)
 {
-	std::string uploadPath = composeUploadPath(client);
-	std::ofstream out(uploadPath.c_str(), std::ios::binary | std::ios::trunc);
-	if (!out.good())
-		THROW_HTTP(500, "Couldn't open upload file for writing");
+	if (!_uploadStream.is_open())
+	{
+		_currentUploadPath = composeUploadPath(client);
+		std::string	partialPath = _currentUploadPath + UPLOAD_PARTIAL_SUFFIX;
+		_uploadStream.open(partialPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!_uploadStream.good())
+			THROW_HTTP(500, "Couldn't open upload file for writing");
+	}
 	if (!_decodedBuffer.empty())
-		out.write(_decodedBuffer.data(), static_cast<std::streamsize>(_decodedBuffer.size()));
-	out.close();
+		_uploadStream.write(_decodedBuffer.data(), static_cast<std::streamsize>(_decodedBuffer.size()));
+	if (!_uploadStream.good())
+		THROW_HTTP(500, "Couldn't write upload file");
 	_decodedBuffer.clear();
 }
 
+void	PostRequestHandler::writeBodyPart(ClientPtr &client)
+{
+	flushUpload(client);
+	_uploadStream.close();
+	std::string	partialPath = _currentUploadPath + UPLOAD_PARTIAL_SUFFIX;
+	if (rename(partialPath.c_str(), _currentUploadPath.c_str()) == -1)
+		THROW_HTTP(500, "Couldn't move upload into place");
+	_currentUploadPath.clear();
+}
+
 BodyReadStatus	PostRequestHandler::getContentLengthBody(ClientPtr &client)
 {
 	if (_bodyBytesExpected == 0)
@@ -74,8 +100,8 @@ BodyReadStatus	PostRequestHandler::getContentLengthBody(ClientPtr &client)
 		size_t	serverMax = client->getOwnerServer()->getClientBodySize();
 		if (_bodyBytesReceived + toCopy > serverMax)
 			THROW_HTTP(413, "Content too large");
-		_bodyBuffer.append(client->getBuffer(), 0, toCopy);
-		client->getBuffer().erase(0, toCopy);
+		_bodyBuffer.append(client->getBuffer().data(), toCopy);
+		client->getBuffer().consume(toCopy);
 		_bodyBytesReceived += toCopy;
 	}
 
@@ -91,22 +117,21 @@ BodyReadStatus	PostRequestHandler::getChunkedBody(ClientPtr &client)
 	{
 		if (_readingChunkSize)
 		{
-			size_t lineEnd = client->getBuffer().find("\r\n");
-			if (lineEnd == std::string::npos)
-			{
-				if (client->getBuffer().size() > MAX_CHUNK_SIZE)
-					THROW_HTTP(413, "Content too large");
+			ReadBuffer	&buffer = client->getBuffer();
+			size_t lineEnd = scan::findCrlf(buffer.data(), buffer.size());
+			if (lineEnd == buffer.size())
 				return BodyReadStatus::NEED_MORE;
-			}
-			std::string sizeLine = client->getBuffer().substr(0, lineEnd);
-			client->getBuffer().erase(0, lineEnd + 2);
-			if (sizeLine.empty())
+			if (lineEnd == 0)
 				THROW_HTTP(400, "Chunk size line is empty");
-			unsigned long chunkSize = 0;
-			std::istringstream iss(sizeLine);
-			iss >> std::hex >> chunkSize;
-			if (iss.fail())
+			uint64_t	chunkSize = 0;
+			size_t		digits = scan::parseHex(buffer.data(), lineEnd, chunkSize);
+			// Only chunk extensions may follow the size; they are ignored
+			size_t		rest = digits;
+			while (rest < lineEnd && (buffer[rest] == ' ' || buffer[rest] == '\t'))
+				++rest;
+			if (digits == 0 || (rest < lineEnd && buffer[rest] != ';'))
 				THROW_HTTP(400, "Bad request");
+			buffer.consume(lineEnd + 2);
 			size_t	serverMax = client->getOwnerServer()->getClientBodySize();
 			if (chunkSize > MAX_CHUNK_SIZE || _bodyBytesReceived + chunkSize > serverMax)
 				THROW_HTTP(413, "Content too large");
@@ -120,21 +145,18 @@ BodyReadStatus	PostRequestHandler::getChunkedBody(ClientPtr &client)
 
 		if (_parsingChunkTrailers)
 		{
-			if (client->getBuffer().size() >= 2 && client->getBuffer().substr(0, 2) == "\r\n")
+			if (client->getBuffer().view().substr(0, 2) == "\r\n")
 			{
-				client->getBuffer().erase(0, 2);
+				client->getBuffer().consume(2);
 				_chunkedFinished = true;
 				_parsingChunkTrailers = false;
 				return BodyReadStatus::COMPLETE;
 			}
-			size_t trailerEnd = client->getBuffer().find("\r\n\r\n");
-			if (trailerEnd == std::string::npos)
-			{
-				if (client->getBuffer().size() > MAX_CHUNK_SIZE)
-					THROW_HTTP(413, "Content too large");
+			ReadBuffer	&buffer = client->getBuffer();
+			size_t trailerEnd = scan::findDoubleCrlf(buffer.data(), buffer.size());
+			if (trailerEnd == buffer.size())
 				return BodyReadStatus::NEED_MORE;
-			}
-			client->getBuffer().erase(0, trailerEnd + 4);
+			buffer.consume(trailerEnd + 4);
 			_chunkedFinished = true;
 			_parsingChunkTrailers = false;
 			return BodyReadStatus::COMPLETE;
@@ -146,8 +168,8 @@ BodyReadStatus	PostRequestHandler::getChunkedBody(ClientPtr &client)
 				return BodyReadStatus::NEED_MORE;
 			size_t remaining = _currentChunkSize - _currentChunkRead;
 			size_t toCopy = std::min(remaining, client->getBuffer().size());
-			_bodyBuffer.append(client->getBuffer(), 0, toCopy);
-			client->getBuffer().erase(0, toCopy);
+			_bodyBuffer.append(client->getBuffer().data(), toCopy);
+			client->getBuffer().consume(toCopy);
 			_currentChunkRead += toCopy;
 			_bodyBytesReceived += toCopy;
 			if (_currentChunkRead < _currentChunkSize)
@@ -158,7 +180,7 @@ BodyReadStatus	PostRequestHandler::getChunkedBody(ClientPtr &client)
 			return BodyReadStatus::NEED_MORE;
 		if (client->getBuffer()[0] != '\r' || client->getBuffer()[1] != '\n')
 			THROW_HTTP(400, "Bad request");
-		client->getBuffer().erase(0, 2);
+		client->getBuffer().consume(2);
 
 		if (_parsingChunkTrailers)
 			continue;
@@ -185,13 +207,9 @@ bool	PostRequestHandler::extractFilename(std::string &dashBoundary)
 	if (_bodyBuffer.compare(0, 2, "\r\n") == 0)
 		_bodyBuffer.erase(0, 2);
 
-	size_t headersEnd = _bodyBuffer.find("\r\n\r\n");
-	if (headersEnd == std::string::npos)
-	{
-		if (_bodyBuffer.size() > MAX_CHUNK_SIZE)
-			THROW_HTTP(413, "Content too large");
+	size_t headersEnd = scan::findDoubleCrlf(_bodyBuffer.data(), _bodyBuffer.size());
+	if (headersEnd == _bodyBuffer.size())
 		return false;
-	}
 	std::string			headers = _bodyBuffer.substr(0, headersEnd);
 	std::istringstream	iss(headers);
 	std::string			line;
@@ -263,6 +281,8 @@ bool	PostRequestHandler::getMultiPart(ClientPtr &client)
 			size_t toAppend = _bodyBuffer.size() - tail;
 			_decodedBuffer.append(_bodyBuffer.data(), toAppend);
 			_bodyBuffer.erase(0, toAppend);
+			if (_decodedBuffer.size() >= UPLOAD_FLUSH_SIZE)
+				flushUpload(client);
 		}
 		return false;
 	}
@@ -322,6 +342,13 @@ void	PostRequestHandler::processPostCgi(ClientPtr &client, BodyReadStatus status
 
 void	PostRequestHandler::resetBodyState()
 {
+	// An upload cut short leaves no partial file behind
+	if (_uploadStream.is_open())
+	{
+		_uploadStream.close();
+		unlink((_currentUploadPath + UPLOAD_PARTIAL_SUFFIX).c_str());
+	}
+	_currentUploadPath.clear();
 	_uploadFilename.clear();
 	_bodyBuffer.shrink_to_fit();
 	_bodyBuffer.clear();
@@ -336,12 +363,26 @@ void	PostRequestHandler::resetBodyState()
 	_readingChunkSize = true;
 	_parsingChunkTrailers = false;
 	_chunkedFinished = false;
+	_multipartFinished = false;
+}
+
+// Getters + Setters
+
+// Bytes held while waiting for a delimiter; decoded upload bytes are
+// written through to disk and only counted in the capacity
+size_t	PostRequestHandler::getBufferedSize()
+{
+	return _bodyBuffer.size();
+}
+
+size_t	PostRequestHandler::getBufferCapacity()
+{
+	return _bodyBuffer.capacity() + _decodedBuffer.capacity();
 }
 
 // Constructors + Destructor
 
-PostRequestHandler::PostRequestHandler(IpPort &owner)
-	: _ipPort(owner)
+PostRequestHandler::PostRequestHandler()
 {
 	resetBodyState();
 }
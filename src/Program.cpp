@@ -1,176 +1,374 @@
 #include "Program.hpp"
+#include "Worker.hpp"
+#include "Scan.hpp"
 
-Time	g_current_time = std::chrono::steady_clock::now();
+ConfigSnapshotPtr	Program::loadConfig(GlobalConfig &globalConfig, uint64_t generation)
+{
+	ConfigParser					configParser;
+	std::shared_ptr<ConfigSnapshot>	snapshot = std::make_shared<ConfigSnapshot>();
+
+	configParser.parseConfig(_confPath);
+	configParser.createServersFromConfig(*snapshot);
+	if (snapshot->servers.empty()) {
+		THROW("none of servers was created");
+	}
+	snapshot->generation = generation;
+	globalConfig = configParser.getGlobalConfig();
+	return snapshot;
+}
 
 void	Program::parseConfFile(char *conf_file)
 {
+	_confPath = conf_file ? conf_file : DEFAULT_CONF;
 	try {
-		ConfigParser configParser;
-
-		if (conf_file) {
-			configParser.parseConfig(std::string(conf_file));
-		} else {
-			configParser.parseConfig(std::string(DEFAULT_CONF));
-		}
-
-		configParser.createServersAndIpPortsFromConfig(*this);
-
-		if (_servers.empty()) {
-			THROW("none of servers was created");
-		}
+		_snapshot.store(loadConfig(_globalConfig, 1));
 	} catch (const std::exception& e) {
 		std::string err = std::string("parsing error: ") + e.what();
 		THROW(err.c_str());
 	}
 }
 
-void	Program::initSockets()
+void	Program::setCommandLine(char **av)
 {
-	addrinfo	hints;
-	int			err;
-	epoll_event	&ev = _ev;
+	char	resolved[PATH_MAX];
 
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_flags = AI_PASSIVE;
+	_exePath = realpath(av[0], resolved) ? resolved : av[0];
+	for (int i = 0; av[i]; ++i)
+		_args.push_back(av[i]);
+}
+
+// Control signals are blocked before any worker thread exists, so every
+// thread inherits the mask and they are only consumed through signalfd:
+// SIGHUP reloads the config, SIGUSR2 starts a binary upgrade, SIGQUIT
+// stops accepting and exits once the last client is done, SIGUSR1 logs
+// the admission counters, SIGCHLD reports an upgrade binary that died.
+void	Program::initSignals()
+{
+	sigset_t	mask;
 
 	signal(SIGPIPE, SIG_IGN);
-	_epollFd = epoll_create(DEFAULT_EPOLL_SIZE);
-	if (_epollFd == -1)
-		THROW_ERRNO("epoll_create");
-	utils::makeFdNoninheritable(_epollFd);
-	for (IpPortPtr &ipPort: _addrPortVec)
-	{
-		ipPort->OpenSocket(hints, &_servInfo);
-		ev.events = EPOLLIN | EPOLLOUT;
-		ev.data.fd = ipPort->getSockFd();
-		_handlersMap.emplace(ipPort->getSockFd(), ipPort.get());
-		err = epoll_ctl(_epollFd, EPOLL_CTL_ADD, ipPort->getSockFd(), &ev);
-		if (err)
-			THROW_ERRNO("epoll_ctl");
-		freeaddrinfo(_servInfo);
-		_servInfo = nullptr;
-	}
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGHUP);
+	sigaddset(&mask, SIGUSR2);
+	sigaddset(&mask, SIGQUIT);
+	sigaddset(&mask, SIGUSR1);
+	sigaddset(&mask, SIGCHLD);
+	if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0)
+		THROW("pthread_sigmask");
+	_signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (_signalFd == -1)
+		THROW_ERRNO("signalfd");
 }
 
-void	Program::waitEpollEvent()
+// systemd socket-activation protocol: LISTEN_FDS sockets starting at fd 3,
+// optionally addressed to us through LISTEN_PID. They are matched to
+// listen directives by their bound address, not by position.
+void	Program::collectInheritedSockets()
 {
-	std::cout << "Waiting for epoll event..." << std::endl;
-	while (true)
+	const char	*listenFds = getenv("LISTEN_FDS");
+	const char	*listenPid = getenv("LISTEN_PID");
+
+	if (!listenFds || (listenPid && atoi(listenPid) != getpid()))
+		return;
+	int	count = atoi(listenFds);
+	for (int fd = LISTEN_FDS_START; fd < LISTEN_FDS_START + count; ++fd)
 	{
-		g_current_time = std::chrono::steady_clock::now();
-		int timeoutMs = 0;
-		if (g_current_time < _nextTimeoutCheck)
+		InheritedSocket	socket;
+		socket.fd = fd;
+		socket.addrLen = sizeof(socket.addr);
+		int			listening = 0;
+		socklen_t	optLen = sizeof(listening);
+		if (getsockname(fd, reinterpret_cast<sockaddr*>(&socket.addr), &socket.addrLen) == -1
+			|| getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &optLen) == -1)
 		{
-			auto tempTime = std::chrono::duration_cast<std::chrono::milliseconds>(_nextTimeoutCheck - g_current_time).count();
-			timeoutMs = static_cast<int>(tempTime);
+			LOG_WARN("Ignoring inherited fd ", fd, ": ", strerror(errno));
+			continue;
 		}
-
-		g_current_time = std::chrono::steady_clock::now();
-		if (g_current_time >= _nextTimeoutCheck)
+		if (!listening)
 		{
-			checkTimeOut();
-			_nextTimeoutCheck = g_current_time + std::chrono::seconds(TIMEOUT_SECONDS);
+			LOG_WARN("Ignoring inherited fd ", fd, ": not a listening socket");
+			continue;
 		}
+		utils::makeFdNoninheritable(fd);
+		_inheritedSockets.push_back(socket);
+	}
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_PID");
+}
 
-		int	nbr_events = epoll_wait(_epollFd, _events, MAX_EVENTS, timeoutMs);
-		if (nbr_events == -1)
-			THROW_ERRNO("epoll_wait");
-		for (int i = 0; i < nbr_events; ++i)
+int	Program::takeInheritedSocket(const sockaddr *addr, socklen_t addrLen)
+{
+	for (auto it = _inheritedSockets.begin(); it != _inheritedSockets.end(); ++it)
+	{
+		if (it->addrLen == addrLen && memcmp(&it->addr, addr, addrLen) == 0)
 		{
-			int		eventFd = _events[i].data.fd;
-			auto	fdHandlerPair = _handlersMap.find(eventFd);
-			if (fdHandlerPair == _handlersMap.end())
-				THROW("Unknown fd in map");
-			(*fdHandlerPair).second->handleEpollEvent(_events[i], eventFd);
+			int	fd = it->fd;
+			_inheritedSockets.erase(it);
+			return fd;
 		}
 	}
+	return -1;
 }
 
-void	Program::checkTimeOut()
+void	Program::closeUnclaimedSockets()
 {
-	try
+	for (InheritedSocket &socket : _inheritedSockets)
 	{
-		std::vector<int> toClose;
-		toClose.reserve(_clientsMap.size());
-		for (auto &fdClient : _clientsMap)
-		{
-			int clientFd = fdClient.first;
-			ClientPtr &client = fdClient.second;
-			auto timeDiff = g_current_time - client->getLastActivity();
-			auto notActiveTime = std::chrono::duration_cast<std::chrono::seconds>(timeDiff).count();
-			if (notActiveTime >= TIMEOUT_SECONDS)
-			{
-				if (client->isTimeout())
-					toClose.push_back(clientFd);
-				else
-				{
-					client->setTimeout(true);
-					client->setLastActivity(g_current_time);
-				}
-			}
-		}
-		for (auto &clientFd : toClose)
+		LOG_WARN("Closing inherited fd ", socket.fd, ": no listen directive matches it");
+		close(socket.fd);
+	}
+	_inheritedSockets.clear();
+}
+
+void	Program::initSockets()
+{
+	Logger::setLevel(_globalConfig.logLevel);
+	LOG_INFO("Parser scan kernels: ", scan::implementation());
+	initSignals();
+	collectInheritedSockets();
+	for (int id = 0; id < _globalConfig.workerThreads; ++id)
+	{
+		WorkerPtr	worker = std::make_shared<Worker>(*this, id);
+		_workers.push_back(worker);
+		worker->initSockets();
+	}
+	// A previous binary with more workers handed over more sockets per
+	// address than there are workers here. Closing one would reset the
+	// connections queued on it, so they are spread over the workers.
+	for (size_t id = 0; !_inheritedSockets.empty(); ++id)
+		if (!_workers[id % _workers.size()]->adoptInheritedListener())
+			break;
+	closeUnclaimedSockets();
+	_workers.front()->watchFd(_signalFd, EPOLLIN, this);
+
+	// Our listeners are up, so the binary that spawned us can stop accepting
+	const char	*parentPid = getenv(UPGRADE_PARENT_ENV);
+	if (parentPid && atoi(parentPid) == getppid())
+	{
+		LOG_INFO("Upgrade: took over listeners, asking ", parentPid, " to drain");
+		kill(getppid(), SIGQUIT);
+	}
+	unsetenv(UPGRADE_PARENT_ENV);
+}
+
+// Runs on worker 0's thread. Every worker's listeners are passed on, each
+// with its own accept queue in the SO_REUSEPORT group: one left behind
+// would be closed by its worker on drain, resetting what is queued on it.
+// Everything the child needs is built before fork(), since only
+// async-signal-safe calls are allowed between fork() and execve() in a
+// threaded process.
+void	Program::spawnUpgrade()
+{
+	std::vector<int>			listenFds;
+	std::vector<std::string>	envStorage;
+	std::vector<char*>			envp;
+	std::vector<char*>			argv;
+
+	for (WorkerPtr &worker : _workers)
+		worker->collectListenFds(listenFds);
+
+	for (char **env = environ; *env; ++env)
+		envStorage.push_back(*env);
+	envStorage.push_back("LISTEN_FDS=" + std::to_string(listenFds.size()));
+	envStorage.push_back(std::string(UPGRADE_PARENT_ENV) + "=" + std::to_string(getpid()));
+	for (std::string &entry : envStorage)
+		envp.push_back(entry.data());
+	envp.push_back(nullptr);
+	for (std::string &arg : _args)
+		argv.push_back(arg.data());
+	argv.push_back(nullptr);
+
+	if (_upgradePid != -1)
+	{
+		LOG_WARN("Upgrade: ", _upgradePid, " already started, ignoring SIGUSR2");
+		return;
+	}
+	LOG_INFO("Upgrade: starting ", _exePath, " with ", listenFds.size(), " inherited listeners");
+	pid_t	pid = fork();
+	if (pid == -1)
+	{
+		LOG_ERROR("Upgrade failed: fork: ", strerror(errno));
+		return;
+	}
+	if (pid == 0)
+	{
+		sigset_t	emptyMask;
+		int			count = listenFds.size();
+
+		sigemptyset(&emptyMask);
+		sigprocmask(SIG_SETMASK, &emptyMask, nullptr);
+		// Move the sockets above the target range first so dup2 can't
+		// clobber a listener that already sits at 3..3+count
+		for (int &fd : listenFds)
+			fd = fcntl(fd, F_DUPFD, LISTEN_FDS_START + count);
+		for (int i = 0; i < count; ++i)
 		{
-			auto fdClient = _clientsMap.find(clientFd);
-			if (fdClient != _clientsMap.end())
-			{
-				try {
-					fdClient->second->setKeepAlive(false);
-					fdClient->second->getIpPort().generateResponse(fdClient->second, "", 408);
-				}
-				catch (std::exception& e) {
-					_addrPortVec.front()->closeConnection(clientFd);
-				}
-			}
+			dup2(listenFds[i], LISTEN_FDS_START + i);
+			close(listenFds[i]);
 		}
+		execve(_exePath.c_str(), argv.data(), envp.data());
+		_exit(EXIT_FAILURE);
+	}
+	_upgradePid = pid;
+}
+
+// A new binary that takes over sends us SIGQUIT and outlives us, so if it
+// exits first the upgrade failed and this process is still the one
+// serving. CGI children are reaped by their Cgi, so only the upgrade pid
+// is waited for here.
+void	Program::reapUpgrade()
+{
+	int	status;
+
+	if (_upgradePid == -1 || waitpid(_upgradePid, &status, WNOHANG) != _upgradePid)
+		return;
+	if (WIFEXITED(status))
+		LOG_ERROR("Upgrade failed: ", _upgradePid, " exited with status ", WEXITSTATUS(status), ", keeping this process");
+	else
+		LOG_ERROR("Upgrade failed: ", _upgradePid, " killed by signal ", WTERMSIG(status), ", keeping this process");
+	_upgradePid = -1;
+}
+
+void	Program::drainWorkers()
+{
+	LOG_INFO("Draining: no longer accepting, exiting once clients are done");
+	for (WorkerPtr &worker : _workers)
+		worker->requestDrain();
+}
+
+void	Program::reportStats()
+{
+	std::lock_guard<std::mutex>	lock(_listenerStatsMutex);
+
+	LOG_INFO("Connections: active ", _connectionStats.active.load(),
+		" accepted ", _connectionStats.accepted.load(),
+		" rejected ", _connectionStats.rejected.load(),
+		" evicted ", _connectionStats.evicted.load(),
+		" paused ", _connectionStats.paused.load(),
+		" shed ", _connectionStats.shed.load());
+	LOG_INFO("Buffer memory: used ", _bufferMemory.used.load(),
+		" peak ", _bufferMemory.peak.load(),
+		" limit ", _globalConfig.maxBufferMemory,
+		" refused ", _bufferMemory.refused.load());
+	for (auto &entry : _listenerStats)
+	{
+		ConnectionStats	&stats = *entry.second;
+		LOG_INFO("Listener ", entry.first, ": active ", stats.active.load(),
+			" accepted ", stats.accepted.load(),
+			" rejected ", stats.rejected.load(),
+			" evicted ", stats.evicted.load(),
+			" paused ", stats.paused.load(),
+			" shed ", stats.shed.load());
+	}
+	for (WorkerPtr &worker : _workers)
+	{
+		LOG_INFO("Worker ", worker->getId(), " loop lag: ", worker->getLoopLag().summary());
+		LOG_INFO("Worker ", worker->getId(), " timer lateness: ", worker->getTimerWheel().getLateness().summary());
+	}
+}
+
+void	Program::runWorkers()
+{
+	if (_workers.size() == 1)
+		return _workers.front()->waitEpollEvent();
+
+	for (WorkerPtr &worker : _workers)
+		worker->start();
+	for (WorkerPtr &worker : _workers)
+		worker->join();
+}
+
+// Only server blocks and log_level take effect on reload; the remaining
+// global directives size the workers and need a restart.
+void	Program::reloadConfig()
+{
+	GlobalConfig		globalConfig;
+	ConfigSnapshotPtr	current = _snapshot.load();
+
+	LOG_INFO("Reloading configuration from ", _confPath);
+	try
+	{
+		_snapshot.store(loadConfig(globalConfig, current->generation + 1));
 	}
 	catch (std::exception &e)
 	{
-		std::cerr << "checkTimeOut error: " << e.what() << std::endl;
+		LOG_ERROR("Reload failed, keeping current configuration: ", e.what());
+		return;
+	}
+	Logger::setLevel(globalConfig.logLevel);
+	for (WorkerPtr &worker : _workers)
+		worker->notifyReload();
+}
+
+void	Program::handleEpollEvent(epoll_event &ev, int eventFd)
+{
+	signalfd_siginfo	info;
+
+	(void)ev;
+	while (read(eventFd, &info, sizeof(info)) == sizeof(info))
+	{
+		if (info.ssi_signo == SIGHUP)
+			reloadConfig();
+		else if (info.ssi_signo == SIGUSR2)
+			spawnUpgrade();
+		else if (info.ssi_signo == SIGQUIT)
+			drainWorkers();
+		else if (info.ssi_signo == SIGUSR1)
+			reportStats();
+		else if (info.ssi_signo == SIGCHLD)
+			reapUpgrade();
 	}
 }
 
 // Getters + Setters
 
-int	&Program::getEpollFd()
+GlobalConfig	&Program::getGlobalConfig()
 {
-	return _epollFd;
+	return _globalConfig;
 }
 
-FdClientMap	&Program::getClientsMap()
+ConnectionStats	&Program::getConnectionStats()
 {
-	return _clientsMap;
+	return _connectionStats;
 }
 
-FdEpollOwnerMap	&Program::getHandlersMap()
+MemoryBudget	&Program::getBufferMemory()
 {
-	return _handlersMap;
+	return _bufferMemory;
 }
 
-IpPortDeq &Program::getAddrPortVec()
+// Every worker's IpPort for an address shares one entry, so a per-server
+// limit holds across workers. Entries outlive reloads that drop the address.
+ConnectionStatsPtr	Program::getListenerStats(const std::string &addrPort)
 {
-	return _addrPortVec;
+	std::lock_guard<std::mutex>	lock(_listenerStatsMutex);
+	ConnectionStatsPtr			&stats = _listenerStats[addrPort];
+
+	if (!stats)
+		stats = std::make_shared<ConnectionStats>();
+	return stats;
 }
 
-ServerDeq &Program::getServers()
+ConfigSnapshotPtr	Program::getSnapshot()
 {
-	return _servers;
+	return _snapshot.load();
+}
+
+WorkerDeq &Program::getWorkers()
+{
+	return _workers;
 }
 
 // Constructors + Destructor
 
 Program::Program()
-	: _epollFd{-1}
-	, _servInfo{nullptr}
-	, _nextTimeoutCheck{g_current_time + std::chrono::seconds(TIMEOUT_SECONDS)}
+	: _signalFd{-1}
+	, _upgradePid{-1}
 {}
 
 Program::~Program()
 {
-	freeaddrinfo(_servInfo);
-	if (_epollFd != -1)
-		close(_epollFd);
+	_workers.clear();
+	if (_signalFd != -1)
+		close(_signalFd);
 }
-
@@ -0,0 +1,105 @@
+#include "ReadBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/uio.h>
+
+// Makes room for freeSpace bytes after the tail: first by sliding the
+// unread bytes to the front, then by growing to the next power of two.
+void	ReadBuffer::reserve(size_t freeSpace)
+{
+	if (_capacity - _tail >= freeSpace)
+		return;
+	size_t	unread = size();
+	if (_capacity - unread >= freeSpace && _storage)
+	{
+		memmove(_storage.get(), data(), unread);
+		_head = 0;
+		_tail = unread;
+		return;
+	}
+	size_t	capacity = _capacity ? _capacity : READ_BUFFER_MIN_HINT;
+	while (capacity - unread < freeSpace)
+		capacity *= 2;
+	std::unique_ptr<char[]>	storage(new char[capacity]);
+	if (unread)
+		memcpy(storage.get(), data(), unread);
+	_storage = std::move(storage);
+	_capacity = capacity;
+	_head = 0;
+	_tail = unread;
+}
+
+void	ReadBuffer::append(const char *data, size_t length)
+{
+	reserve(length);
+	memcpy(_storage.get() + _tail, data, length);
+	_tail += length;
+}
+
+// A read that fills the free space doubles the hint for the next one; a
+// read well under it halves it, so idle connections stop reserving room.
+ssize_t	ReadBuffer::readFrom(int fd, size_t maxBytes)
+{
+	char	spill[READ_BUFFER_SPILL_SIZE];
+	iovec	iov[2];
+
+	reserve(std::min(_readHint, maxBytes));
+	size_t	room = std::min(_capacity - _tail, maxBytes);
+	size_t	spillRoom = std::min(sizeof(spill), maxBytes - room);
+	iov[0].iov_base = _storage.get() + _tail;
+	iov[0].iov_len = room;
+	iov[1].iov_base = spill;
+	iov[1].iov_len = spillRoom;
+
+	ssize_t	bytesRead = readv(fd, iov, spillRoom ? 2 : 1);
+	if (bytesRead <= 0)
+		return bytesRead;
+	size_t	got = static_cast<size_t>(bytesRead);
+	if (got > room)
+	{
+		_tail += room;
+		append(spill, got - room);
+	}
+	else
+		_tail += got;
+
+	if (got >= room && _readHint < READ_BUFFER_MAX_HINT)
+		_readHint *= 2;
+	else if (got < _readHint / 4 && _readHint > READ_BUFFER_MIN_HINT)
+		_readHint /= 2;
+	return bytesRead;
+}
+
+void	ReadBuffer::consume(size_t length)
+{
+	_head += length;
+	if (_head >= _tail)
+		_head = _tail = 0;
+}
+
+void	ReadBuffer::clear()
+{
+	_head = _tail = 0;
+}
+
+// Drops the storage of an empty buffer that grew past keepCapacity
+void	ReadBuffer::release(size_t keepCapacity)
+{
+	if (!empty() || _capacity <= keepCapacity)
+		return;
+	_storage.reset();
+	_capacity = 0;
+	_head = _tail = 0;
+	_readHint = READ_BUFFER_MIN_HINT;
+}
+
+// Constructors + Destructor
+
+ReadBuffer::ReadBuffer()
+	: _capacity{0}
+	, _head{0}
+	, _tail{0}
+	, _readHint{READ_BUFFER_MIN_HINT}
+{}
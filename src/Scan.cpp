@@ -0,0 +1,387 @@
+#include "Scan.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define SCAN_X86 1
+#endif
+
+namespace
+{
+
+struct TokenTable
+{
+	bool	isToken[256] = {};
+
+	constexpr TokenTable()
+	{
+		const char	*specials = "!#$%&'*+-.^_`|~";
+
+		for (int c = '0'; c <= '9'; ++c)
+			isToken[c] = true;
+		for (int c = 'A'; c <= 'Z'; ++c)
+			isToken[c] = true;
+		for (int c = 'a'; c <= 'z'; ++c)
+			isToken[c] = true;
+		for (const char *s = specials; *s; ++s)
+			isToken[static_cast<unsigned char>(*s)] = true;
+	}
+};
+
+constexpr TokenTable	g_token;
+
+int	hexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+size_t	findCrlfScalar(const char *data, size_t size)
+{
+	for (size_t i = 0; i + 1 < size; ++i)
+		if (data[i] == '\r' && data[i + 1] == '\n')
+			return i;
+	return size;
+}
+
+size_t	tokenLengthScalar(const char *data, size_t size)
+{
+	size_t	i = 0;
+
+	while (i < size && g_token.isToken[static_cast<unsigned char>(data[i])])
+		++i;
+	return i;
+}
+
+size_t	hexLengthScalar(const char *data, size_t size)
+{
+	size_t	i = 0;
+
+	while (i < size && hexValue(data[i]) >= 0)
+		++i;
+	return i;
+}
+
+size_t	pathCleanLengthScalar(const char *data, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		unsigned char	c = static_cast<unsigned char>(data[i]);
+		if (c == '%' || c < 0x20 || c == 0x7f)
+			return i;
+		if (c == '/' && i + 1 < size && (data[i + 1] == '/' || data[i + 1] == '.'))
+			return i;
+	}
+	return size;
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse4.2")))
+size_t	findCrlfSse42(const char *data, size_t size)
+{
+	const __m128i	cr = _mm_set1_epi8('\r');
+	const __m128i	lf = _mm_set1_epi8('\n');
+	size_t			i = 0;
+
+	for (; i + 17 <= size; i += 16)
+	{
+		__m128i	a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i	b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+		int		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + findCrlfScalar(data + i, size - i);
+}
+
+// PCMPESTRI ranges of bytes that can't be in a token. 8 ranges don't fit
+// the exact set, so '{'..0xff also covers '|' and '~', rechecked on a hit.
+__attribute__((target("sse4.2")))
+size_t	tokenLengthSse42(const char *data, size_t size)
+{
+	alignas(16) static const unsigned char	ranges[16] = {
+		0x00, ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', 0xff
+	};
+	const __m128i	set = _mm_load_si128(reinterpret_cast<const __m128i*>(ranges));
+	size_t			i = 0;
+
+	while (i + 16 <= size)
+	{
+		__m128i	chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		int		index = _mm_cmpestri(set, 16, chunk, 16,
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+		i += index;
+		if (index == 16)
+			continue;
+		if (!g_token.isToken[static_cast<unsigned char>(data[i])])
+			return i;
+		++i;
+	}
+	return i + tokenLengthScalar(data + i, size - i);
+}
+
+// Counts hex digits 16 at a time; the input is copied to a local block
+// when fewer than 16 bytes remain so the load never crosses the end.
+__attribute__((target("sse4.2")))
+size_t	hexLengthSse42(const char *data, size_t size)
+{
+	alignas(16) static const char	ranges[16] = {'0', '9', 'A', 'F', 'a', 'f'};
+	const __m128i	set = _mm_load_si128(reinterpret_cast<const __m128i*>(ranges));
+	size_t			i = 0;
+
+	while (i < size)
+	{
+		size_t	length = size - i < 16 ? size - i : 16;
+		__m128i	chunk;
+		if (length == 16)
+			chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		else
+		{
+			alignas(16) char	block[16] = {};
+			memcpy(block, data + i, length);
+			chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+		}
+		int	index = _mm_cmpestri(set, 6, chunk, static_cast<int>(length),
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+		if (static_cast<size_t>(index) < length)
+			return i + index;
+		i += length;
+	}
+	return i;
+}
+
+// Same shifted-load trick as findCrlf: a[i] is the byte, b[i] the next one
+__attribute__((target("sse4.2")))
+size_t	pathCleanLengthSse42(const char *data, size_t size)
+{
+	const __m128i	percent = _mm_set1_epi8('%');
+	const __m128i	slash = _mm_set1_epi8('/');
+	const __m128i	dot = _mm_set1_epi8('.');
+	const __m128i	del = _mm_set1_epi8(0x7f);
+	const __m128i	lastControl = _mm_set1_epi8(0x1f);
+	size_t			i = 0;
+
+	for (; i + 17 <= size; i += 16)
+	{
+		__m128i	a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i	b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+		__m128i	control = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(a, lastControl), a), _mm_cmpeq_epi8(a, del));
+		__m128i	dotSegment = _mm_and_si128(_mm_cmpeq_epi8(a, slash),
+			_mm_or_si128(_mm_cmpeq_epi8(b, slash), _mm_cmpeq_epi8(b, dot)));
+		int		mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(a, percent), control), dotSegment));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + pathCleanLengthScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+size_t	findCrlfAvx2(const char *data, size_t size)
+{
+	const __m256i	cr = _mm256_set1_epi8('\r');
+	const __m256i	lf = _mm256_set1_epi8('\n');
+	size_t			i = 0;
+
+	for (; i + 33 <= size; i += 32)
+	{
+		__m256i		a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i		b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+		uint32_t	mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + findCrlfSse42(data + i, size - i);
+}
+
+// Nibble lookup: lowTable[lo] has bit h set when byte (h << 4 | lo) is a
+// token character, highTable[hi] is 1 << hi for ASCII and 0 above.
+struct NibbleTables
+{
+	alignas(32) unsigned char	low[32] = {};
+	alignas(32) unsigned char	high[32] = {};
+
+	constexpr NibbleTables()
+	{
+		for (int c = 0; c < 128; ++c)
+			if (g_token.isToken[c])
+			{
+				low[c & 0x0f] |= 1 << (c >> 4);
+				low[16 + (c & 0x0f)] |= 1 << (c >> 4);
+			}
+		for (int hi = 0; hi < 8; ++hi)
+		{
+			high[hi] = 1 << hi;
+			high[16 + hi] = 1 << hi;
+		}
+	}
+};
+
+constexpr NibbleTables	g_nibbles;
+
+__attribute__((target("avx2")))
+size_t	tokenLengthAvx2(const char *data, size_t size)
+{
+	const __m256i	lowTable = _mm256_load_si256(reinterpret_cast<const __m256i*>(g_nibbles.low));
+	const __m256i	highTable = _mm256_load_si256(reinterpret_cast<const __m256i*>(g_nibbles.high));
+	const __m256i	nibbleMask = _mm256_set1_epi8(0x0f);
+	size_t			i = 0;
+
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i		chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i		lowBits = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(chunk, nibbleMask));
+		__m256i		highBits = _mm256_shuffle_epi8(highTable,
+			_mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibbleMask));
+		__m256i		miss = _mm256_cmpeq_epi8(_mm256_and_si256(lowBits, highBits), _mm256_setzero_si256());
+		uint32_t	mask = _mm256_movemask_epi8(miss);
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + tokenLengthSse42(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+size_t	pathCleanLengthAvx2(const char *data, size_t size)
+{
+	const __m256i	percent = _mm256_set1_epi8('%');
+	const __m256i	slash = _mm256_set1_epi8('/');
+	const __m256i	dot = _mm256_set1_epi8('.');
+	const __m256i	del = _mm256_set1_epi8(0x7f);
+	const __m256i	lastControl = _mm256_set1_epi8(0x1f);
+	size_t			i = 0;
+
+	for (; i + 33 <= size; i += 32)
+	{
+		__m256i		a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i		b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+		__m256i		control = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(a, lastControl), a),
+			_mm256_cmpeq_epi8(a, del));
+		__m256i		dotSegment = _mm256_and_si256(_mm256_cmpeq_epi8(a, slash),
+			_mm256_or_si256(_mm256_cmpeq_epi8(b, slash), _mm256_cmpeq_epi8(b, dot)));
+		uint32_t	mask = _mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(a, percent), control), dotSegment));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + pathCleanLengthSse42(data + i, size - i);
+}
+
+#endif
+
+struct Kernels
+{
+	size_t		(*findCrlf)(const char*, size_t);
+	size_t		(*tokenLength)(const char*, size_t);
+	size_t		(*hexLength)(const char*, size_t);
+	size_t		(*pathCleanLength)(const char*, size_t);
+	const char	*name;
+};
+
+// Kernel sets this CPU can run, fastest first
+const std::vector<Kernels>	&availableKernels()
+{
+	static const std::vector<Kernels>	available = [] {
+		std::vector<Kernels>	list;
+#ifdef SCAN_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			list.push_back({findCrlfAvx2, tokenLengthAvx2, hexLengthSse42, pathCleanLengthAvx2, "avx2"});
+		if (__builtin_cpu_supports("sse4.2"))
+			list.push_back({findCrlfSse42, tokenLengthSse42, hexLengthSse42, pathCleanLengthSse42, "sse4.2"});
+#endif
+		list.push_back({findCrlfScalar, tokenLengthScalar, hexLengthScalar, pathCleanLengthScalar, "scalar"});
+		return list;
+	}();
+
+	return available;
+}
+
+Kernels	&kernels()
+{
+	static Kernels	selected = availableKernels().front();
+
+	return selected;
+}
+
+}
+
+namespace scan
+{
+
+size_t	findCrlf(const char *data, size_t size)
+{
+	return kernels().findCrlf(data, size);
+}
+
+size_t	findDoubleCrlf(const char *data, size_t size)
+{
+	size_t	offset = 0;
+
+	while (true)
+	{
+		size_t	found = offset + findCrlf(data + offset, size - offset);
+		if (found + 4 > size)
+			return size;
+		if (data[found + 2] == '\r' && data[found + 3] == '\n')
+			return found;
+		offset = found + 2;
+	}
+}
+
+size_t	tokenLength(const char *data, size_t size)
+{
+	return kernels().tokenLength(data, size);
+}
+
+size_t	parseHex(const char *data, size_t size, uint64_t &value)
+{
+	size_t	digits = kernels().hexLength(data, size);
+
+	if (digits == 0 || digits > 16)
+		return 0;
+	value = 0;
+	for (size_t i = 0; i < digits; ++i)
+		value = (value << 4) | static_cast<uint64_t>(hexValue(data[i]));
+	return digits;
+}
+
+size_t	pathCleanLength(const char *data, size_t size)
+{
+	return kernels().pathCleanLength(data, size);
+}
+
+const char	*implementation()
+{
+	return kernels().name;
+}
+
+std::vector<const char*>	implementations()
+{
+	std::vector<const char*>	names;
+
+	for (const Kernels &set : availableKernels())
+		names.push_back(set.name);
+	return names;
+}
+
+bool	useImplementation(const char *name)
+{
+	for (const Kernels &set : availableKernels())
+	{
+		if (strcmp(set.name, name) == 0)
+		{
+			kernels() = set;
+			return true;
+		}
+	}
+	return false;
+}
+
+}
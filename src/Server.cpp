@@ -1,51 +1,58 @@
 #include "Server.hpp"
 
-bool	Server::areHeadersValid(ClientPtr &client)
+// Everything a routed request is checked against before it is handled.
+// Refusals come back as values; only a misconfigured redirect throws.
+HttpError	Server::validateRequest(ClientPtr &client)
 {
 	const Location	*matchedLocation = findLocationForPath(client->getHttpPath());
 
 	if (!matchedLocation)
-		THROW_HTTP(404, "No matched location");
+		return HTTP_ERROR(404, "No matched location");
 
 	if (client->getHttpVersion() != HTTP_VERSION)
-		THROW_HTTP(505, "HTTP Version Not Supported");
+		return HTTP_ERROR(505, "HTTP Version Not Supported");
+
+	client->setNoDelay(matchedLocation->tcpNodelay);
 
 	if (isRedirected(client, matchedLocation))
 	{
 		client->getIpPort().generateResponse(client, "", client->getRedirectCode());
-		return true;
+		return {};
 	}
 
 	if (client->getContentLen() > 0 && client->isChunked())
-		THROW_HTTP(415, "Chunked body and content-length are presented");
+		return HTTP_ERROR(415, "Chunked body and content-length are presented");
 
 	if (!isMethodAllowed(client, matchedLocation))
-		THROW_HTTP(405, "Method not allowed");
+		return HTTP_ERROR(405, "Method not allowed");
 
 	if (!isBodySizeValid(client))
-		THROW_HTTP(413, "Content too large");
+		return HTTP_ERROR(413, "Content too large");
 
 	if (client->getContentType().find(CONTENT_TYPE_MULTIPART) != std::string::npos
 		&& client->getMultipartBoundary().empty())
 	{
-		THROW_HTTP(400, "Multipart boundary missing");
+		return HTTP_ERROR(400, "Multipart boundary missing");
 	}
 
-	if (client->getHttpMethod()== "POST"
+	if (client->getHttpMethod() == HttpMethod::POST
 		&& client->getContentType().find(CONTENT_TYPE_MULTIPART) == std::string::npos
 		&& client->getContentType().find(CONTENT_TYPE_APP_FORM) == std::string::npos)
 	{
-		THROW_HTTP(415, "Unsupported media type");
+		return HTTP_ERROR(415, "Unsupported media type");
 	}
 
-	std::string	path = findFile(client, client->getHttpPath(), matchedLocation);
+	std::string	path;
+	HttpError	error = findFile(client, client->getHttpPath(), matchedLocation, path);
+	if (error)
+		return error;
 	client->setResolvedPath(path);
 
 	if (client->getResolvedPath().empty())
-		THROW_HTTP(404, "Not Found");
+		return HTTP_ERROR(404, "Not Found");
 
-	if (client->getFileType() == FileType::DIRECTORY && client->getHttpMethod() == "DELETE")
-		THROW_HTTP(405, "DELETE not allowed for directories");
+	if (client->getFileType() == FileType::DIRECTORY && client->getHttpMethod() == HttpMethod::DELETE)
+		return HTTP_ERROR(405, "DELETE not allowed for directories");
 
 	if (client->getFileType() == FileType::CGI_SCRIPT)
 	{
@@ -53,10 +60,10 @@ bool	Server::areHeadersValid(ClientPtr &client)
 		std::string	ext = client->getResolvedPath().substr(dot);
 
 		if (ext != PYTHON_EXT && ext != PHP_EXT)
-			THROW_HTTP(400, "Unsupported cgi");
+			return HTTP_ERROR(400, "Unsupported cgi");
 		client->getCgi().setUploadDir(matchedLocation->uploadDir);
 	}
-	return true;
+	return {};
 }
 
 bool	Server::isRedirected(ClientPtr &client, const Location* matchedLocation)
@@ -99,7 +106,9 @@ const Location* Server::findLocationForPath(std::string& path)
 	return matched;
 }
 
-std::string	Server::findFile(ClientPtr &client, const std::string& path, const Location* matched)
+// Leaves the file to serve in resolved, or leaves it empty when there is
+// nothing to serve and no more specific error applies.
+HttpError	Server::findFile(ClientPtr &client, const std::string& path, const Location* matched, std::string &resolved)
 {
 	std::string	docRoot = matched->root;
 	while (docRoot.back() == '/' || docRoot.back() == '\\')
@@ -113,43 +122,38 @@ std::string	Server::findFile(ClientPtr &client, const std::string& path, const L
 	if (!suffix.empty())
 		fsPath += "/" + suffix;
 
-	if (client->getHttpMethod()== "POST" && matched->isCgi == false)
+	if (client->getHttpMethod() == HttpMethod::POST && matched->isCgi == false)
 	{
 		std::string fsDir = fsPath.empty() ? docRoot : fsPath;
 		struct stat st{};
 		if (stat(fsDir.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
-			return fsDir;
-		return "";
+			resolved = fsDir;
+		return {};
 	}
 
 	if (!suffix.empty() && path.back() != '/')
 	{
 		struct stat st;
-		if (access(fsPath.c_str(), F_OK) != 0)
-			THROW_HTTP(404, "Not Found");
-		if (stat(fsPath.c_str(), &st) == 0)
+		if (stat(fsPath.c_str(), &st) != 0)
+			return HTTP_ERROR(404, "Not Found");
+		if (S_ISREG(st.st_mode))
 		{
-			if (S_ISREG(st.st_mode))
+			if (matched->isCgi == true)
 			{
-				if (matched->isCgi == true)
-				{
-					client->setFileType(FileType::CGI_SCRIPT);
-					if (access(fsPath.c_str(), X_OK) != 0)
-						THROW_HTTP(403, "Forbidden");
-				}
-				else if ((access(fsPath.c_str(), R_OK) != 0 && client->getHttpMethod() == "GET")
-					|| (access(fsPath.c_str(), W_OK) != 0 && client->getHttpMethod() == "POST"))
-				{
-					THROW_HTTP(405, "bidden");
-				}
-				return fsPath;
+				client->setFileType(FileType::CGI_SCRIPT);
+				if (access(fsPath.c_str(), X_OK) != 0)
+					return HTTP_ERROR(403, "Forbidden");
 			}
-			else if (!S_ISDIR(st.st_mode))
+			else if ((access(fsPath.c_str(), R_OK) != 0 && client->getHttpMethod() == HttpMethod::GET)
+				|| (access(fsPath.c_str(), W_OK) != 0 && client->getHttpMethod() == HttpMethod::POST))
 			{
-				THROW_HTTP(400, "Not regular file or directory");
-				return "";
+				return HTTP_ERROR(405, "Forbidden");
 			}
+			resolved = fsPath;
+			return {};
 		}
+		else if (!S_ISDIR(st.st_mode))
+			return HTTP_ERROR(400, "Not regular file or directory");
 	}
 
 	std::vector<std::string> indexFiles;
@@ -174,21 +178,20 @@ std::string	Server::findFile(ClientPtr &client, const std::string& path, const L
 		std::string candidate = fsDir + *it;
 		struct stat st;
 		if (access(candidate.c_str(), R_OK) != 0 && access(candidate.c_str(), X_OK) != 0)
+			return HTTP_ERROR(403, "Forbidden");
+		if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode))
 		{
-			THROW_HTTP(403, "Forbidden");
-			return "";
+			resolved = candidate;
+			return {};
 		}
-		if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode))
-			return candidate;
 	}
 
-	if (matched->autoindex && client->getHttpMethod() != "DELETE")
+	if (matched->autoindex && client->getHttpMethod() != HttpMethod::DELETE)
 	{
 		client->setFileType(FileType::DIRECTORY);
-		return fsDir;
+		resolved = fsDir;
 	}
-
-	return "";
+	return {};
 }
 
 bool	Server::isBodySizeValid(ClientPtr &client)
@@ -198,14 +201,8 @@ bool	Server::isBodySizeValid(ClientPtr &client)
 
 bool	Server::isMethodAllowed(ClientPtr &client, const Location* matchedLocation)
 {
-	int methodFlag = 0;
-	if (client->getHttpMethod()== "GET")
-		methodFlag = static_cast<int>(HttpMethod::GET);
-	else if (client->getHttpMethod()== "POST")
-		methodFlag = static_cast<int>(HttpMethod::POST);
-	else if (client->getHttpMethod()== "DELETE")
-		methodFlag = static_cast<int>(HttpMethod::DELETE);
-	else
+	int methodFlag = static_cast<int>(client->getHttpMethod());
+	if (methodFlag == 0)
 		return false;
 
 	bool allowed = (matchedLocation->allowedMethods & methodFlag) != 0;
@@ -268,6 +265,14 @@ size_t Server::getClientBodySize() {
 	return _clientBodySize;
 }
 
+int Server::getMaxConnections() {
+	return _maxConnections;
+}
+
+bool Server::isTcpNopush() {
+	return _tcpNopush;
+}
+
 const std::map<int, std::string>& Server::getErrorPages() {
 	return _errorPages;
 }
@@ -286,8 +291,13 @@ Server::Server(const ServerConfig& config)
 	_host(config.getHost()),
 	_port(std::to_string(config.getPort())),
 	_clientBodySize(config.clientMaxBodySize),
+	_maxConnections(config.maxConnections),
+	_tcpNopush(config.tcpNopush),
 	_errorPages(config.errorPages),
 	_locations(config.locations)
-
-{}
+{
+	for (auto &location : _locations)
+		if (location.tcpNodelay < 0)
+			location.tcpNodelay = config.tcpNodelay;
+}
 
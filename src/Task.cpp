@@ -0,0 +1,94 @@
+#include "Task.hpp"
+
+#include <new>
+
+FramePool	&FramePool::local()
+{
+	static thread_local FramePool	pool;
+
+	return pool;
+}
+
+void	*FramePool::allocate(size_t size)
+{
+	size_t	sizeClass = (size - 1) / FRAME_POOL_GRANULE;
+
+	if (sizeClass >= FRAME_POOL_CLASSES)
+		return ::operator new(size);
+	std::vector<void*>	&freeList = _free[sizeClass];
+	if (freeList.empty())
+		return ::operator new((sizeClass + 1) * FRAME_POOL_GRANULE);
+	void	*frame = freeList.back();
+	freeList.pop_back();
+	return frame;
+}
+
+void	FramePool::deallocate(void *frame, size_t size)
+{
+	size_t	sizeClass = (size - 1) / FRAME_POOL_GRANULE;
+
+	if (sizeClass >= FRAME_POOL_CLASSES || _free[sizeClass].size() >= FRAME_POOL_MAX_FREE)
+		return ::operator delete(frame);
+	_free[sizeClass].push_back(frame);
+}
+
+FramePool::~FramePool()
+{
+	for (std::vector<void*> &freeList : _free)
+		for (void *frame : freeList)
+			::operator delete(frame);
+}
+
+// Runs the coroutine up to its next co_await. Once it has finished the
+// frame is released and an exception it raised is rethrown to the caller.
+// Returns whether the coroutine is still running.
+bool	Task::resume()
+{
+	_handle.resume();
+	if (!_handle.done())
+		return true;
+	std::exception_ptr	exception = _handle.promise().exception;
+	destroy();
+	if (exception)
+		std::rethrow_exception(exception);
+	return false;
+}
+
+void	Task::destroy()
+{
+	if (_handle)
+		_handle.destroy();
+	_handle = nullptr;
+}
+
+// Constructors + Destructor
+
+Task::Task()
+	: _handle{nullptr}
+{}
+
+Task::Task(Handle handle)
+	: _handle{handle}
+{}
+
+Task::Task(Task &&other) noexcept
+	: _handle{other._handle}
+{
+	other._handle = nullptr;
+}
+
+Task	&Task::operator=(Task &&other) noexcept
+{
+	if (this != &other)
+	{
+		destroy();
+		_handle = other._handle;
+		other._handle = nullptr;
+	}
+	return *this;
+}
+
+Task::~Task()
+{
+	destroy();
+}
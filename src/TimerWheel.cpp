@@ -0,0 +1,163 @@
+#include "TimerWheel.hpp"
+
+uint64_t	TimerWheel::toTick(Time t)
+{
+	if (t <= _start)
+		return 0;
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t - _start).count();
+	return static_cast<uint64_t>(ms) / TIMER_TICK_MS;
+}
+
+void	TimerWheel::initSlot(TimerNode &head)
+{
+	head.prev = &head;
+	head.next = &head;
+}
+
+void	TimerWheel::link(TimerNode &node)
+{
+	uint64_t	delta = node.expiry - _currentTick;
+	TimerNode	*head;
+
+	if (delta < TIMER_LEVEL0_SIZE)
+		head = &_level0[node.expiry & (TIMER_LEVEL0_SIZE - 1)];
+	else
+	{
+		int	level = 1;
+		int	shift = TIMER_LEVEL0_BITS;
+		while (level < TIMER_LEVELS - 1 && delta >= (1ULL << (shift + TIMER_LEVELN_BITS)))
+		{
+			++level;
+			shift += TIMER_LEVELN_BITS;
+		}
+		head = &_levels[level - 1][(node.expiry >> shift) & (TIMER_LEVELN_SIZE - 1)];
+	}
+	node.next = head;
+	node.prev = head->prev;
+	head->prev->next = &node;
+	head->prev = &node;
+}
+
+void	TimerWheel::unlink(TimerNode &node)
+{
+	node.prev->next = node.next;
+	node.next->prev = node.prev;
+	node.prev = nullptr;
+	node.next = nullptr;
+}
+
+// Re-links every node of the current slot of an upper level; they land in
+// lower levels now that they are less than one revolution away.
+void	TimerWheel::cascade(int level)
+{
+	int			shift = TIMER_LEVEL0_BITS + (level - 1) * TIMER_LEVELN_BITS;
+	size_t		index = (_currentTick >> shift) & (TIMER_LEVELN_SIZE - 1);
+	TimerNode	&head = _levels[level - 1][index];
+
+	if (index == 0 && level < TIMER_LEVELS - 1)
+		cascade(level + 1);
+	while (head.next != &head)
+	{
+		TimerNode	&node = *head.next;
+		unlink(node);
+		link(node);
+	}
+}
+
+void	TimerWheel::schedule(TimerNode &node, Time deadline)
+{
+	uint64_t	expiry = toTick(deadline);
+
+	if (node.isLinked())
+		unlink(node);
+	else
+		++_count;
+	if (expiry < _currentTick)
+		expiry = _currentTick;
+	if (expiry - _currentTick > TIMER_MAX_TICKS)
+		expiry = _currentTick + TIMER_MAX_TICKS;
+	node.expiry = expiry;
+	link(node);
+}
+
+void	TimerWheel::cancel(TimerNode &node)
+{
+	if (!node.isLinked())
+		return;
+	unlink(node);
+	--_count;
+}
+
+void	TimerWheel::advance(Time now, std::vector<int> &expired)
+{
+	uint64_t	nowTick = toTick(now);
+
+	while (_currentTick <= nowTick)
+	{
+		size_t	index = _currentTick & (TIMER_LEVEL0_SIZE - 1);
+		if (index == 0)
+			cascade(1);
+		TimerNode	&head = _level0[index];
+		Time		slotTime = _start + std::chrono::milliseconds(_currentTick * TIMER_TICK_MS);
+		while (head.next != &head)
+		{
+			_lateness.record(now - slotTime);
+			TimerNode	&node = *head.next;
+			unlink(node);
+			--_count;
+			expired.push_back(node.key);
+		}
+		++_currentTick;
+		if (_count == 0)
+			_currentTick = std::max(_currentTick, nowTick + 1);
+	}
+}
+
+// Milliseconds until the next non-empty level 0 slot, or until level 0 wraps
+// and upper levels have to be cascaded. -1 blocks forever on an empty wheel.
+int	TimerWheel::getNextTimeoutMs(Time now)
+{
+	if (_count == 0)
+		return -1;
+
+	uint64_t	tick = _currentTick;
+	for (size_t i = 0; i < TIMER_LEVEL0_SIZE; ++i, ++tick)
+	{
+		size_t	index = tick & (TIMER_LEVEL0_SIZE - 1);
+		if ((index == 0 && i != 0) || _level0[index].next != &_level0[index])
+			break;
+	}
+	auto	deadline = _start + std::chrono::milliseconds(tick * TIMER_TICK_MS);
+	if (deadline <= now)
+		return 0;
+	auto	ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+	return static_cast<int>(ms) + 1;
+}
+
+size_t	TimerWheel::size()
+{
+	return _count;
+}
+
+// How long after its slot came due each timer was actually run
+const LatencyHistogram	&TimerWheel::getLateness()
+{
+	return _lateness;
+}
+
+// Constructors + Destructor
+
+TimerWheel::TimerWheel(Time now)
+	: _start{now}
+	, _currentTick{0}
+	, _count{0}
+{
+	for (TimerNode &head : _level0)
+		initSlot(head);
+	for (auto &level : _levels)
+		for (TimerNode &head : level)
+			initSlot(head);
+}
+
+TimerWheel::~TimerWheel()
+{}
@@ -0,0 +1,103 @@
+#include "UriPath.hpp"
+
+#include "Scan.hpp"
+
+namespace
+{
+
+int	hexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+// Decodes one segment. A decoded '/' would move the segment boundaries
+// after routing has seen them, so it is refused along with control bytes.
+HttpError	decodeSegment(std::string_view raw, std::string &segment)
+{
+	segment.clear();
+	for (size_t i = 0; i < raw.size(); ++i)
+	{
+		unsigned char	c = static_cast<unsigned char>(raw[i]);
+		if (c == '%')
+		{
+			int	high = i + 2 < raw.size() ? hexValue(raw[i + 1]) : -1;
+			int	low = high >= 0 ? hexValue(raw[i + 2]) : -1;
+			if (low < 0)
+				return HTTP_ERROR(400, "Malformed percent-encoding");
+			c = static_cast<unsigned char>(high << 4 | low);
+			i += 2;
+			if (c == '/')
+				return HTTP_ERROR(400, "Encoded '/' in path");
+		}
+		if (c < 0x20 || c == 0x7f)
+			return HTTP_ERROR(400, "Control character in path");
+		segment.push_back(static_cast<char>(c));
+	}
+	return {};
+}
+
+}
+
+namespace uri
+{
+
+// The kernel finds the first byte that needs work. Everything before the
+// '/' that opens that segment is already canonical and is copied as is;
+// the rest is rebuilt segment by segment.
+HttpError	normalizePath(std::string_view raw, std::string &out)
+{
+	if (raw.empty() || raw[0] != '/')
+		return HTTP_ERROR(400, "Request target is not an absolute path");
+
+	size_t	clean = scan::pathCleanLength(raw.data(), raw.size());
+	if (clean == raw.size())
+	{
+		out.assign(raw);
+		return {};
+	}
+	size_t	start = raw[clean] == '/' ? clean : raw.rfind('/', clean);
+	out.assign(raw.substr(0, start));
+
+	std::string	segment;
+	size_t		pos = start;
+	HttpError	error;
+	while (pos < raw.size())
+	{
+		size_t	end = raw.find('/', pos + 1);
+		if (end == std::string_view::npos)
+			end = raw.size();
+		bool	last = end == raw.size();
+		if ((error = decodeSegment(raw.substr(pos + 1, end - pos - 1), segment)))
+			return error;
+		pos = end;
+
+		if (segment.empty() || segment == ".")
+		{
+			if (last)
+				out.push_back('/');
+			continue;
+		}
+		if (segment == "..")
+		{
+			if (out.empty())
+				return HTTP_ERROR(400, "Path escapes the document root");
+			out.erase(out.rfind('/'));
+			if (last)
+				out.push_back('/');
+			continue;
+		}
+		out.push_back('/');
+		out.append(segment);
+	}
+	if (out.empty())
+		out.push_back('/');
+	return {};
+}
+
+}
@@ -0,0 +1,543 @@
+#include "UringBackend.hpp"
+
+static uint64_t	packUserData(UringOp op, int fd, uint32_t serial)
+{
+	return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(serial & URING_SERIAL_MASK) << 32)
+		| static_cast<uint32_t>(fd);
+}
+
+// EPOLLIN on an fd with a multishot operation is that operation's job, so
+// a poll only watches what is left
+static uint32_t	pollEvents(uint32_t events)
+{
+	if (events & EVENT_COMPLETION_MASK)
+		events &= ~static_cast<uint32_t>(EPOLLIN);
+	return events & ~(static_cast<uint32_t>(EPOLLET) | EVENT_COMPLETION_MASK);
+}
+
+static bool	wantsStream(uint32_t events)
+{
+	return (events & EPOLLIN) && (events & EVENT_COMPLETION_MASK);
+}
+
+// Whether a serial was handed out since the fd's current registration
+static bool	isCurrent(const UringFdState &state, uint32_t serial)
+{
+	return ((serial - state.registration) & URING_SERIAL_MASK)
+		<= ((state.serial - state.registration) & URING_SERIAL_MASK);
+}
+
+// Makes room for count SQEs in a row, submitting what is queued if needed,
+// so a linked pair is never split across two submissions
+void	UringBackend::reserveSqes(unsigned count)
+{
+	if (_sqTailLocal - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) + count <= _params.sq_entries)
+		return;
+	enter(0, 0);
+	if (_sqTailLocal - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) + count > _params.sq_entries)
+		THROW("io_uring submission queue is full");
+}
+
+io_uring_sqe	*UringBackend::getSqe()
+{
+	reserveSqes(1);
+	unsigned		index = _sqTailLocal & *_sqMask;
+	io_uring_sqe	*sqe = &_sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	_sqArray[index] = index;
+	++_sqTailLocal;
+	return sqe;
+}
+
+// Submits everything queued so far and optionally waits for completions.
+int	UringBackend::enter(unsigned minComplete, int timeoutMs)
+{
+	unsigned					flags = 0;
+	io_uring_getevents_arg		arg;
+	__kernel_timespec			ts;
+	void						*argPtr = nullptr;
+	size_t						argSize = 0;
+
+	if (minComplete > 0)
+	{
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeoutMs >= 0)
+		{
+			memset(&arg, 0, sizeof(arg));
+			ts.tv_sec = timeoutMs / 1000;
+			ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+			arg.ts = reinterpret_cast<uint64_t>(&ts);
+			flags |= IORING_ENTER_EXT_ARG;
+			argPtr = &arg;
+			argSize = sizeof(arg);
+		}
+	}
+	__atomic_store_n(_sqTail, _sqTailLocal, __ATOMIC_RELEASE);
+	unsigned	toSubmit = _sqTailLocal - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+	int			ret = syscall(__NR_io_uring_enter, _ringFd, toSubmit, minComplete, flags, argPtr, argSize);
+	if (ret == -1)
+	{
+		if (errno == ETIME || errno == EINTR || errno == EBUSY)
+			return 0;
+		THROW_ERRNO("io_uring_enter");
+	}
+	return ret;
+}
+
+UringFdState	&UringBackend::getFdState(int fd)
+{
+	if (static_cast<size_t>(fd) >= _fdStates.size())
+		_fdStates.resize(fd + 1);
+	return _fdStates[fd];
+}
+
+void	UringBackend::arm(int fd)
+{
+	UringFdState	&state = getFdState(fd);
+	io_uring_sqe	*sqe = getSqe();
+
+	++state.generation;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = pollEvents(state.events);
+	sqe->len = (state.events & EPOLLET) ? IORING_POLL_ADD_MULTI : 0;
+	sqe->user_data = packUserData(UringOp::POLL, fd, state.generation);
+	state.armed = true;
+}
+
+void	UringBackend::disarm(int fd)
+{
+	UringFdState	&state = getFdState(fd);
+
+	if (!state.armed)
+		return;
+	io_uring_sqe	*sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = packUserData(UringOp::POLL, fd, state.generation);
+	sqe->user_data = URING_IGNORE_CQE;
+	state.armed = false;
+}
+
+void	UringBackend::startStream(int fd)
+{
+	UringFdState	&state = getFdState(fd);
+	io_uring_sqe	*sqe = getSqe();
+
+	state.streamSerial = ++state.serial;
+	sqe->fd = fd;
+	if (state.events & EVENT_ACCEPT)
+	{
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+		sqe->user_data = packUserData(UringOp::ACCEPT, fd, state.streamSerial);
+	}
+	else
+	{
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_BUFFER_GROUP;
+		sqe->user_data = packUserData(UringOp::RECV, fd, state.streamSerial);
+	}
+	state.streaming = true;
+}
+
+// What the operation took before the cancel lands is still reported
+void	UringBackend::stopStream(int fd)
+{
+	UringFdState	&state = getFdState(fd);
+
+	if (!state.streaming)
+		return;
+	cancel(packUserData((state.events & EVENT_ACCEPT) ? UringOp::ACCEPT : UringOp::RECV, fd, state.streamSerial));
+	state.streaming = false;
+}
+
+void	UringBackend::cancel(uint64_t userData)
+{
+	io_uring_sqe	*sqe = getSqe();
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = userData;
+	sqe->user_data = URING_IGNORE_CQE;
+}
+
+// Brings the kernel side in line with the interest: a poll for what needs
+// one, the multishot operation while EPOLLIN is wanted
+void	UringBackend::update(int fd)
+{
+	UringFdState	&state = getFdState(fd);
+
+	if (pollEvents(state.events) && !state.armed)
+		arm(fd);
+	if (wantsStream(state.events) && !state.streaming)
+		startStream(fd);
+	else if (!wantsStream(state.events))
+		stopStream(fd);
+}
+
+void	UringBackend::add(int fd, uint32_t events, uint64_t token)
+{
+	UringFdState	&state = getFdState(fd);
+
+	disarm(fd);
+	stopStream(fd);
+	state.events = events;
+	state.token = token;
+	state.registration = ++state.serial;
+	state.sending = false;
+	update(fd);
+}
+
+void	UringBackend::modify(int fd, uint32_t events, uint64_t token)
+{
+	UringFdState	&state = getFdState(fd);
+
+	if (pollEvents(state.events) != pollEvents(events))
+		disarm(fd);
+	state.events = events;
+	state.token = token;
+	update(fd);
+}
+
+void	UringBackend::remove(int fd)
+{
+	UringFdState	&state = getFdState(fd);
+
+	disarm(fd);
+	stopStream(fd);
+	if (state.sending)
+		cancel(packUserData(UringOp::SEND, fd, state.sendBuffer));
+	state.sending = false;
+	state.events = 0;
+}
+
+// A pending operation pins the file, so everything on the fd is cancelled
+// before it is closed; the cancels are submitted with the next wait.
+void	UringBackend::release(int fd)
+{
+	remove(fd);
+}
+
+// Submits queued changes now instead of with the next wait, for callers
+// that need the kernel to drop its file reference before they go on.
+void	UringBackend::flush()
+{
+	enter(0, 0);
+}
+
+bool	UringBackend::isCompletionBased()
+{
+	return true;
+}
+
+uint32_t	UringBackend::acquireSendBuffer()
+{
+	uint32_t	index;
+
+	if (_freeSendBuffers.empty())
+	{
+		index = _sendBuffers.size();
+		_sendBuffers.emplace_back();
+	}
+	else
+	{
+		index = _freeSendBuffers.back();
+		_freeSendBuffers.pop_back();
+	}
+	if (!_sendBuffers[index].data)
+		_sendBuffers[index].data.reset(new char[URING_SEND_BUFFER_SIZE]);
+	return index;
+}
+
+void	UringBackend::releaseSendBuffer(uint32_t index)
+{
+	if (_freeSendBuffers.size() >= URING_SEND_BUFFERS_KEPT)
+		_sendBuffers[index].data.reset();
+	_freeSendBuffers.push_back(index);
+}
+
+// The chunk's READ is linked ahead of the SEND, so the send only starts on
+// a full read; a short or failed one cancels it, which fails the send.
+void	UringBackend::send(int fd, const char *data, size_t length, const FileChunk *chunk)
+{
+	UringFdState	&state = getFdState(fd);
+	uint32_t		index = acquireSendBuffer();
+	char			*buffer = _sendBuffers[index].data.get();
+	size_t			copied = std::min(length, static_cast<size_t>(URING_SEND_BUFFER_SIZE));
+	size_t			fromFile = chunk ? std::min(chunk->length, URING_SEND_BUFFER_SIZE - copied) : 0;
+
+	memcpy(buffer, data, copied);
+	_sendBuffers[index].serial = state.serial;
+	reserveSqes(2);
+	if (fromFile)
+	{
+		io_uring_sqe	*read = getSqe();
+		read->opcode = IORING_OP_READ;
+		read->fd = chunk->fd;
+		read->addr = reinterpret_cast<uint64_t>(buffer + copied);
+		read->len = fromFile;
+		read->off = chunk->offset;
+		read->flags = IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS;
+		read->user_data = URING_IGNORE_CQE;
+	}
+	io_uring_sqe	*sqe = getSqe();
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(buffer);
+	sqe->len = copied + fromFile;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = packUserData(UringOp::SEND, fd, index);
+	state.sendBuffer = index;
+	state.sending = true;
+}
+
+std::vector<Completion>	&UringBackend::getCompletions()
+{
+	return _completions;
+}
+
+// Entries start at the ring itself, the first one overlapping the tail.
+// Not through bufs: the empty member in front of it moves it in C++.
+void	UringBackend::provideBuffer(uint16_t bid)
+{
+	io_uring_buf	*buffer = reinterpret_cast<io_uring_buf*>(_bufferRing) + (_bufferTail & (URING_RECV_BUFFERS - 1));
+
+	buffer->addr = reinterpret_cast<uint64_t>(_recvBuffers + static_cast<size_t>(bid) * URING_RECV_BUFFER_SIZE);
+	buffer->len = URING_RECV_BUFFER_SIZE;
+	buffer->bid = bid;
+	++_bufferTail;
+}
+
+// The previous batch's handlers have copied their bytes out by now
+void	UringBackend::recycleBuffers()
+{
+	if (_usedBuffers.empty())
+		return;
+	for (uint16_t bid : _usedBuffers)
+		provideBuffer(bid);
+	_usedBuffers.clear();
+	__atomic_store_n(&_bufferRing->tail, _bufferTail, __ATOMIC_RELEASE);
+}
+
+// A one-shot poll is re-armed before the next wait, once the handler had
+// its chance to change the interest
+bool	UringBackend::harvestPoll(int fd, uint32_t generation, int res, uint32_t flags, epoll_event &event)
+{
+	UringFdState	&state = getFdState(fd);
+
+	if (!state.armed || (state.generation & URING_SERIAL_MASK) != generation)
+		return false;
+	if (!(flags & IORING_CQE_F_MORE))
+		state.armed = false;
+	if (res == -ECANCELED)
+		return false;
+	if (!state.armed)
+		_rearm.push_back(fd);
+	event.events = res < 0 ? static_cast<uint32_t>(EPOLLERR) : static_cast<uint32_t>(res);
+	event.data.u64 = state.token;
+	return true;
+}
+
+// A multishot operation that ended is restarted before the next wait while
+// the interest still wants it, except a recv that hit end of input; ENOBUFS
+// only means the buffers ran out, so the retry waits for them to come back.
+// A connection accepted for a listener that is gone is closed here.
+void	UringBackend::harvestCompletion(UringOp op, int fd, uint32_t serial, int res, uint32_t flags)
+{
+	UringFdState	&state = getFdState(fd);
+	const char		*data = nullptr;
+
+	if (op == UringOp::SEND)
+	{
+		uint32_t	index = serial;
+		serial = _sendBuffers[index].serial & URING_SERIAL_MASK;
+		releaseSendBuffer(index);
+		if (state.sending && state.sendBuffer == index)
+			state.sending = false;
+	}
+	else
+	{
+		if (flags & IORING_CQE_F_BUFFER)
+		{
+			uint16_t	bid = flags >> IORING_CQE_BUFFER_SHIFT;
+			_usedBuffers.push_back(bid);
+			data = _recvBuffers + static_cast<size_t>(bid) * URING_RECV_BUFFER_SIZE;
+		}
+		if (state.streaming && (state.streamSerial & URING_SERIAL_MASK) == serial
+			&& !(flags & IORING_CQE_F_MORE))
+		{
+			state.streaming = false;
+			if (!(op == UringOp::RECV && res == 0) && res != -ECANCELED)
+				_rearm.push_back(fd);
+		}
+		if (res == -ECANCELED || res == -ENOBUFS)
+			return;
+	}
+	if (!isCurrent(state, serial))
+	{
+		if (op == UringOp::ACCEPT && res >= 0)
+			close(res);
+		return;
+	}
+	CompletionOp	completionOp = op == UringOp::ACCEPT ? CompletionOp::ACCEPT
+		: op == UringOp::RECV ? CompletionOp::RECV : CompletionOp::SEND;
+	_completions.push_back(Completion{completionOp, res, data, state.token});
+}
+
+int	UringBackend::harvest(std::vector<epoll_event> &events)
+{
+	unsigned	head = *_cqHead;
+	unsigned	tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+	size_t		count = 0;
+
+	while (head != tail && count + _completions.size() < events.size())
+	{
+		io_uring_cqe	*cqe = &_cqes[head & *_cqMask];
+		uint64_t		userData = cqe->user_data;
+		int				res = cqe->res;
+		uint32_t		flags = cqe->flags;
+		++head;
+
+		if (userData == URING_IGNORE_CQE)
+			continue;
+		UringOp		op = static_cast<UringOp>(userData >> 56);
+		int			fd = static_cast<int>(userData & 0xffffffff);
+		uint32_t	serial = static_cast<uint32_t>(userData >> 32) & URING_SERIAL_MASK;
+		if (op != UringOp::POLL)
+			harvestCompletion(op, fd, serial, res, flags);
+		else if (harvestPoll(fd, serial, res, flags, events[count]))
+			++count;
+	}
+	__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+	return count;
+}
+
+int	UringBackend::wait(std::vector<epoll_event> &events, int timeoutMs)
+{
+	recycleBuffers();
+	_completions.clear();
+	for (int fd : _rearm)
+		update(fd);
+	_rearm.clear();
+
+	int	count = harvest(events);
+	if (count > 0 || !_completions.empty())
+		return count;
+	enter(timeoutMs == 0 ? 0 : 1, timeoutMs);
+	return harvest(events);
+}
+
+void	UringBackend::mapRings(unsigned entries)
+{
+	_ringFd = syscall(__NR_io_uring_setup, std::max(entries, static_cast<unsigned>(URING_MIN_ENTRIES)), &_params);
+	if (_ringFd == -1)
+		THROW_ERRNO("io_uring_setup");
+	if (!(_params.features & IORING_FEAT_SINGLE_MMAP) || !(_params.features & IORING_FEAT_EXT_ARG)
+		|| !(_params.features & IORING_FEAT_CQE_SKIP))
+		THROW("io_uring: kernel lacks SINGLE_MMAP, EXT_ARG or CQE_SKIP");
+
+	size_t	sqSize = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+	size_t	cqSize = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+	_ringSize = std::max(sqSize, cqSize);
+	_ringPtr = mmap(nullptr, _ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+	if (_ringPtr == MAP_FAILED)
+		THROW_ERRNO("mmap(io_uring ring)");
+	_sqesSize = _params.sq_entries * sizeof(io_uring_sqe);
+	_sqes = static_cast<io_uring_sqe*>(mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES));
+	if (_sqes == MAP_FAILED)
+		THROW_ERRNO("mmap(io_uring sqes)");
+
+	char	*ring = static_cast<char*>(_ringPtr);
+	_sqHead = reinterpret_cast<unsigned*>(ring + _params.sq_off.head);
+	_sqTail = reinterpret_cast<unsigned*>(ring + _params.sq_off.tail);
+	_sqMask = reinterpret_cast<unsigned*>(ring + _params.sq_off.ring_mask);
+	_sqArray = reinterpret_cast<unsigned*>(ring + _params.sq_off.array);
+	_cqHead = reinterpret_cast<unsigned*>(ring + _params.cq_off.head);
+	_cqTail = reinterpret_cast<unsigned*>(ring + _params.cq_off.tail);
+	_cqMask = reinterpret_cast<unsigned*>(ring + _params.cq_off.ring_mask);
+	_cqes = reinterpret_cast<io_uring_cqe*>(ring + _params.cq_off.cqes);
+	_sqTailLocal = *_sqTail;
+}
+
+// Registers the provided buffer ring multishot recvs pick from and fills it
+void	UringBackend::setupBufferRing()
+{
+	void	*ring = mmap(nullptr, URING_RECV_BUFFERS * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring == MAP_FAILED)
+		THROW_ERRNO("mmap(io_uring buffer ring)");
+	_bufferRing = static_cast<io_uring_buf_ring*>(ring);
+	void	*buffers = mmap(nullptr, static_cast<size_t>(URING_RECV_BUFFERS) * URING_RECV_BUFFER_SIZE,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers == MAP_FAILED)
+		THROW_ERRNO("mmap(io_uring recv buffers)");
+	_recvBuffers = static_cast<char*>(buffers);
+
+	io_uring_buf_reg	reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uint64_t>(_bufferRing);
+	reg.ring_entries = URING_RECV_BUFFERS;
+	reg.bgid = URING_BUFFER_GROUP;
+	if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+		THROW_ERRNO("io_uring_register(PBUF_RING)");
+	for (unsigned bid = 0; bid < URING_RECV_BUFFERS; ++bid)
+		provideBuffer(static_cast<uint16_t>(bid));
+	__atomic_store_n(&_bufferRing->tail, _bufferTail, __ATOMIC_RELEASE);
+}
+
+// Closing the ring first has the kernel drop its operations before the
+// memory they point into goes away
+void	UringBackend::teardown()
+{
+	if (_ringFd != -1)
+		close(_ringFd);
+	_ringFd = -1;
+	if (_sqes != MAP_FAILED)
+		munmap(_sqes, _sqesSize);
+	if (_ringPtr != MAP_FAILED)
+		munmap(_ringPtr, _ringSize);
+	if (_bufferRing)
+		munmap(_bufferRing, URING_RECV_BUFFERS * sizeof(io_uring_buf));
+	if (_recvBuffers)
+		munmap(_recvBuffers, static_cast<size_t>(URING_RECV_BUFFERS) * URING_RECV_BUFFER_SIZE);
+	_sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	_ringPtr = MAP_FAILED;
+	_bufferRing = nullptr;
+	_recvBuffers = nullptr;
+}
+
+// Constructors + Destructor
+
+UringBackend::UringBackend(unsigned entries)
+	: _ringFd{-1}
+	, _ringPtr{MAP_FAILED}
+	, _ringSize{0}
+	, _sqes{static_cast<io_uring_sqe*>(MAP_FAILED)}
+	, _sqesSize{0}
+	, _bufferRing{nullptr}
+	, _recvBuffers{nullptr}
+	, _bufferTail{0}
+	, _sqTailLocal{0}
+{
+	memset(&_params, 0, sizeof(_params));
+	try
+	{
+		mapRings(entries);
+		setupBufferRing();
+	}
+	catch (std::exception &e)
+	{
+		teardown();
+		throw;
+	}
+}
+
+UringBackend::~UringBackend()
+{
+	teardown();
+}
@@ -0,0 +1,658 @@
+#include "Worker.hpp"
+#include "Program.hpp"
+
+thread_local Time	g_current_time = std::chrono::steady_clock::now();
+
+void	Worker::createEventBackend()
+{
+	if (_program.getGlobalConfig().eventBackend == "uring")
+	{
+		try
+		{
+			_eventBackend = std::make_unique<UringBackend>(_events.size() * 2);
+			_socketEventFlags = _edgeTriggerFlag | EVENT_RECV;
+			return;
+		}
+		catch (std::exception &e)
+		{
+			LOG_WARN("Worker ", _id, ": io_uring unavailable, falling back to epoll: ", e.what());
+		}
+	}
+	_eventBackend = std::make_unique<EpollBackend>();
+	_socketEventFlags = _edgeTriggerFlag;
+}
+
+void	Worker::watchFd(int fd, uint32_t events, IEpollFdOwner *owner)
+{
+	_handlersTable.emplace(fd, owner);
+	try
+	{
+		_eventBackend->add(fd, events, _handlersTable.getToken(fd));
+	}
+	catch (std::exception &e)
+	{
+		_handlersTable.erase(fd);
+		throw;
+	}
+}
+
+// Returns false only with inheritedOnly, when no inherited socket is left
+bool	Worker::openListener(IpPort &ipPort, bool inheritedOnly)
+{
+	addrinfo	hints;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	try
+	{
+		ipPort.OpenSocket(hints, &_servInfo, inheritedOnly);
+		if (ipPort.getSockFd() != -1)
+			watchFd(ipPort.getSockFd(), EPOLLIN | EVENT_ACCEPT, &ipPort);
+	}
+	catch (std::exception &e)
+	{
+		freeaddrinfo(_servInfo);
+		_servInfo = nullptr;
+		ipPort.closeSocket();
+		throw;
+	}
+	freeaddrinfo(_servInfo);
+	_servInfo = nullptr;
+	return ipPort.getSockFd() != -1;
+}
+
+void	Worker::closeListener(IpPort &ipPort)
+{
+	int	sockFd = ipPort.getSockFd();
+
+	if (ipPort.isPaused())
+	{
+		ipPort.setPaused(false);
+		--_pausedListeners;
+	}
+	_eventBackend->release(sockFd);
+	_eventBackend->flush();
+	_handlersTable.erase(sockFd);
+	ipPort.closeSocket();
+}
+
+void	Worker::initSockets()
+{
+	ConfigSnapshotPtr	snapshot = _program.getSnapshot();
+
+	createEventBackend();
+	_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_wakeFd == -1)
+		THROW_ERRNO("eventfd");
+	watchFd(_wakeFd, EPOLLIN, this);
+
+	for (auto &addrPortServers : snapshot->addrPortServers)
+	{
+		IpPortPtr	ipPort = std::make_shared<IpPort>(*this);
+		ipPort->setAddrPort(addrPortServers.first);
+		ipPort->setListenConfig(snapshot->listenConfigs.at(addrPortServers.first));
+		ipPort->getServers() = addrPortServers.second;
+		_addrPortVec.push_back(ipPort);
+		openListener(*ipPort, false);
+	}
+	_configGeneration = snapshot->generation;
+}
+
+// Called from worker 0's thread for an upgrade, while this worker may be
+// applying a reload or starting to drain
+void	Worker::collectListenFds(std::vector<int> &fds)
+{
+	std::lock_guard<std::mutex>	lock(_listenersMutex);
+
+	for (IpPortPtr &ipPort : _addrPortVec)
+		if (ipPort->getSockFd() != -1)
+			fds.push_back(ipPort->getSockFd());
+}
+
+// Takes one more of the sockets the previous binary handed over, as an
+// extra listener next to the one this worker already has for its address.
+// Returns false once none of them matches a listen directive.
+bool	Worker::adoptInheritedListener()
+{
+	ConfigSnapshotPtr	snapshot = _program.getSnapshot();
+
+	for (auto &addrPortServers : snapshot->addrPortServers)
+	{
+		IpPortPtr	ipPort = std::make_shared<IpPort>(*this);
+		ipPort->setAddrPort(addrPortServers.first);
+		ipPort->setListenConfig(snapshot->listenConfigs.at(addrPortServers.first));
+		ipPort->getServers() = addrPortServers.second;
+		if (openListener(*ipPort, true))
+		{
+			_addrPortVec.push_back(ipPort);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Listeners are diffed by address: kept ones only get the new server list,
+// so their sockets (and accept queues) survive the reload. A removed
+// listener stops accepting, but its IpPort stays alive for the clients
+// still attached to it and is reopened if the address comes back.
+void	Worker::applySnapshot(const ConfigSnapshotPtr &snapshot)
+{
+	const AddrPortServersMap	&addrPortServers = snapshot->addrPortServers;
+	std::lock_guard<std::mutex>	lock(_listenersMutex);
+
+	for (IpPortPtr &ipPort : _addrPortVec)
+	{
+		auto	entry = addrPortServers.find(ipPort->getAddrPort());
+		if (entry == addrPortServers.end())
+		{
+			if (ipPort->getSockFd() != -1)
+			{
+				closeListener(*ipPort);
+				LOG_INFO("Worker ", _id, ": stopped listening on ", ipPort->getAddrPort());
+			}
+			continue;
+		}
+		ipPort->getServers() = entry->second;
+		ipPort->setListenConfig(snapshot->listenConfigs.at(entry->first));
+		if (ipPort->getSockFd() == -1)
+			reopenListener(*ipPort);
+		else
+			updateListenOptions(*ipPort);
+	}
+	for (auto &entry : addrPortServers)
+	{
+		auto	known = std::find_if(_addrPortVec.begin(), _addrPortVec.end(),
+			[&entry](IpPortPtr &ipPort) { return ipPort->getAddrPort() == entry.first; });
+		if (known != _addrPortVec.end())
+			continue;
+		IpPortPtr	ipPort = std::make_shared<IpPort>(*this);
+		ipPort->setAddrPort(entry.first);
+		ipPort->setListenConfig(snapshot->listenConfigs.at(entry.first));
+		ipPort->getServers() = entry.second;
+		_addrPortVec.push_back(ipPort);
+		reopenListener(*ipPort);
+	}
+	_configGeneration = snapshot->generation;
+	LOG_INFO("Worker ", _id, ": configuration generation ", _configGeneration, " applied");
+}
+
+void	Worker::reopenListener(IpPort &ipPort)
+{
+	try
+	{
+		openListener(ipPort, false);
+		LOG_INFO("Worker ", _id, ": listening on ", ipPort.getAddrPort());
+	}
+	catch (std::exception &e)
+	{
+		LOG_ERROR("Worker ", _id, ": cannot listen on ", ipPort.getAddrPort(), ": ", e.what());
+	}
+}
+
+void	Worker::updateListenOptions(IpPort &ipPort)
+{
+	try
+	{
+		ipPort.applyListenOptions();
+	}
+	catch (std::exception &e)
+	{
+		LOG_ERROR("Worker ", _id, ": cannot update listen options of ", ipPort.getAddrPort(), ": ", e.what());
+	}
+}
+
+// Takes the pending accept queue first, then closes every listener. Idle
+// keep-alive connections are closed right away; busy ones, and the ones
+// just accepted whose first request is still unread, finish their
+// response and are closed instead of kept alive.
+void	Worker::startDrain()
+{
+	std::vector<int>	idleFds;
+
+	_draining = true;
+	{
+		std::lock_guard<std::mutex>	lock(_listenersMutex);
+		for (IpPortPtr &ipPort : _addrPortVec)
+		{
+			if (ipPort->getSockFd() == -1)
+				continue;
+			ipPort->acceptConnection();
+			closeListener(*ipPort);
+		}
+	}
+	_clientsTable.forEach([&idleFds](int fd, ClientPtr &client) {
+		if (client->getTimerPhase() == TimerPhase::KEEPALIVE && client->getBuffer().empty())
+			idleFds.push_back(fd);
+	});
+	for (int fd : idleFds)
+		_clientsTable.at(fd)->getIpPort().closeConnection(fd);
+	LOG_INFO("Worker ", _id, ": draining ", _clientsTable.size(), " connections");
+}
+
+void	Worker::wake()
+{
+	uint64_t	one = 1;
+
+	if (write(_wakeFd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+		LOG_ERROR("Worker ", _id, ": failed to wake: ", strerror(errno));
+}
+
+void	Worker::notifyReload()
+{
+	wake();
+}
+
+void	Worker::requestDrain()
+{
+	_drainRequested.store(true);
+	wake();
+}
+
+void	Worker::pauseListener(IpPort &ipPort)
+{
+	int	sockFd = ipPort.getSockFd();
+
+	if (ipPort.isPaused() || sockFd == -1)
+		return;
+	_eventBackend->modify(sockFd, 0, _handlersTable.getToken(sockFd));
+	ipPort.setPaused(true);
+	++_pausedListeners;
+	_program.getConnectionStats().paused.fetch_add(1, std::memory_order_relaxed);
+	ipPort.getStats().paused.fetch_add(1, std::memory_order_relaxed);
+	LOG_WARN("Worker ", _id, ": connection limit reached, pausing ", ipPort.getAddrPort());
+}
+
+// A listener also resumes while idle keep-alive connections could be
+// evicted for it; acceptConnection pauses it again if that doesn't help.
+void	Worker::resumeListeners()
+{
+	for (IpPortPtr &ipPort : _addrPortVec)
+	{
+		if (!ipPort->isPaused() || (!ipPort->hasCapacity() && !ipPort->canEvictIdle()))
+			continue;
+		int	sockFd = ipPort->getSockFd();
+		_eventBackend->modify(sockFd, EPOLLIN | EVENT_ACCEPT, _handlersTable.getToken(sockFd));
+		ipPort->setPaused(false);
+		--_pausedListeners;
+		LOG_INFO("Worker ", _id, ": resuming ", ipPort->getAddrPort());
+	}
+}
+
+// The listener that has been idle in keep-alive the longest on this worker,
+// for when the global limit is the one that was hit. Keep-alive deadlines
+// all use the same timeout, so the earliest one is the oldest connection.
+IpPort	*Worker::findOldestIdleListener()
+{
+	IpPort			*owner = nullptr;
+	const TimerNode	*oldest = nullptr;
+
+	for (IpPortPtr &ipPort : _addrPortVec)
+	{
+		const TimerNode	*node = ipPort->getIdleList().front();
+		if (node && (!oldest || node->expiry < oldest->expiry))
+		{
+			oldest = node;
+			owner = ipPort.get();
+		}
+	}
+	return owner;
+}
+
+void	Worker::handleEpollEvent(epoll_event &ev, int eventFd)
+{
+	uint64_t			count;
+	ConfigSnapshotPtr	snapshot;
+
+	(void)ev;
+	while (read(eventFd, &count, sizeof(count)) > 0)
+		;
+	if (_drainRequested.load() && !_draining)
+		startDrain();
+	if (_draining)
+		return;
+	snapshot = _program.getSnapshot();
+	if (snapshot->generation != _configGeneration)
+		applySnapshot(snapshot);
+}
+
+// A closed connection leaves the tables at once, so later events of the
+// batch find no owner, but its Client and fd live until the batch is over:
+// a handler may still be running on it, and the fd number can't be reused
+// by an accept in the same batch.
+void	Worker::deferClose(ClientPtr client)
+{
+	_closingClients.push_back(std::move(client));
+}
+
+void	Worker::reapClosedClients()
+{
+	_closingClients.clear();
+}
+
+// Loop lag is the time from epoll_wait returning to the batch being done.
+// Its moving average drives load shedding: above overload_threshold new
+// requests are answered with a prebuilt 503 instead of being routed.
+void	Worker::recordLoopLag(Time batchEnd)
+{
+	Time::duration	lag = batchEnd - g_current_time;
+	uint64_t		lagUs = std::chrono::duration_cast<std::chrono::microseconds>(lag).count();
+	int				thresholdMs = _program.getGlobalConfig().overloadThresholdMs;
+
+	_loopLag.record(lag);
+	_smoothedLagUs += (static_cast<int64_t>(lagUs) - static_cast<int64_t>(_smoothedLagUs)) >> LOOP_LAG_SMOOTHING_SHIFT;
+	bool	overloaded = thresholdMs > 0 && _smoothedLagUs > static_cast<uint64_t>(thresholdMs) * 1000;
+	if (overloaded != _overloaded)
+	{
+		if (overloaded)
+			LOG_WARN("Worker ", _id, ": loop lag ", _smoothedLagUs / 1000, " ms, shedding new requests");
+		else
+			LOG_INFO("Worker ", _id, ": loop lag back to ", _smoothedLagUs / 1000, " ms");
+	}
+	_overloaded = overloaded;
+	_lastBatchEnd = batchEnd;
+}
+
+// The average only moves when batches run, so a worker that sat in
+// epoll_wait for longer than the threshold is known to have caught up.
+void	Worker::checkIdleRecovery()
+{
+	auto	threshold = std::chrono::milliseconds(_program.getGlobalConfig().overloadThresholdMs);
+
+	if (g_current_time - _lastBatchEnd < threshold)
+		return;
+	_smoothedLagUs = 0;
+	_overloaded = false;
+	LOG_INFO("Worker ", _id, ": idle again, no longer shedding");
+}
+
+void	Worker::waitEpollEvent()
+{
+	if (_program.getGlobalConfig().workerCpuAffinity)
+		pinToCpu();
+	LOG_INFO("Worker ", _id, " waiting for epoll event...");
+	while (!_draining || _clientsTable.size() > 0)
+	{
+		int	timeoutMs = _timerWheel.getNextTimeoutMs(g_current_time);
+		if (_pausedListeners > 0 && (timeoutMs < 0 || timeoutMs > ADMISSION_RETRY_MS))
+			timeoutMs = ADMISSION_RETRY_MS;
+		int	nbr_events = _eventBackend->wait(_events, timeoutMs);
+
+		g_current_time = std::chrono::steady_clock::now();
+		if (_overloaded)
+			checkIdleRecovery();
+		handleTimeouts();
+		for (int i = 0; i < nbr_events; ++i)
+		{
+			int				eventFd;
+			IEpollFdOwner	**owner = _handlersTable.findByToken(_events[i].data.u64, eventFd);
+			// Stale token: the fd was closed, and maybe reused, earlier in this batch
+			if (!owner)
+				continue;
+			(*owner)->handleEpollEvent(_events[i], eventFd);
+		}
+		dispatchCompletions();
+		reapClosedClients();
+		if (_pausedListeners > 0)
+			resumeListeners();
+		if (nbr_events > 0 || !_eventBackend->getCompletions().empty() || !_expiredTimers.empty())
+			recordLoopLag(std::chrono::steady_clock::now());
+	}
+	LOG_INFO("Worker ", _id, " drained");
+}
+
+// Same routing as readiness events. A connection accepted for a listener
+// closed earlier in this batch has no owner left, so it is closed here.
+void	Worker::dispatchCompletions()
+{
+	for (Completion &completion : _eventBackend->getCompletions())
+	{
+		int				eventFd;
+		IEpollFdOwner	**owner = _handlersTable.findByToken(completion.token, eventFd);
+		if (owner)
+			(*owner)->handleCompletion(completion, eventFd);
+		else if (completion.op == CompletionOp::ACCEPT && completion.result >= 0)
+			close(completion.result);
+	}
+}
+
+void	Worker::handleTimeouts()
+{
+	_expiredTimers.clear();
+	_timerWheel.advance(g_current_time, _expiredTimers);
+	for (int clientFd : _expiredTimers)
+	{
+		ClientPtr	*clientSlot = _clientsTable.find(clientFd);
+		if (!clientSlot)
+			continue;
+		ClientPtr	&client = *clientSlot;
+		// Taken up front: a failed response may already have closed the
+		// client, leaving the slot empty or handed to a new connection
+		IpPort		&ipPort = client->getIpPort();
+		try
+		{
+			switch (client->getTimerPhase())
+			{
+				case TimerPhase::HEADER:
+					if (client->getBuffer().empty())
+						client->getIpPort().closeConnection(clientFd);
+					else
+					{
+						client->resetRequestData();
+						client->getBuffer().clear();
+						client->getIpPort().generateResponse(client, "", 408);
+					}
+					break;
+				case TimerPhase::BODY:
+					client->resetRequestData();
+					client->getBuffer().clear();
+					client->getIpPort().generateResponse(client, "", 408);
+					break;
+				case TimerPhase::CGI:
+					client->getCgi().terminate();
+					client->resetRequestData();
+					client->getBuffer().clear();
+					client->getIpPort().generateResponse(client, "", 504);
+					break;
+				case TimerPhase::KEEPALIVE:
+				case TimerPhase::SEND:
+					client->getIpPort().closeConnection(clientFd);
+					break;
+			}
+		}
+		catch (std::exception &e)
+		{
+			if (_clientsTable.find(clientFd))
+				ipPort.closeConnection(clientFd);
+		}
+	}
+}
+
+// A worker thread can't hand exceptions back to main(), so it reports
+// them itself.
+void	Worker::run()
+{
+	try
+	{
+		waitEpollEvent();
+	}
+	catch (std::exception &e)
+	{
+		LOG_ERROR("Fatal Error in worker ", _id, ": ", e.what());
+		Logger::stop();
+		_exit(EXIT_FAILURE);
+	}
+}
+
+void	Worker::pinToCpu()
+{
+	cpu_set_t	cpuSet;
+	int			cpuCount = std::thread::hardware_concurrency();
+
+	if (cpuCount <= 0)
+		return;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(_id % cpuCount, &cpuSet);
+	int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+	if (err != 0)
+		LOG_WARN("Worker ", _id, ": failed to pin to cpu: ", strerror(err));
+}
+
+void	Worker::start()
+{
+	_thread = std::thread(&Worker::run, this);
+}
+
+void	Worker::join()
+{
+	if (_thread.joinable())
+		_thread.join();
+}
+
+// Getters + Setters
+
+Program	&Worker::getProgram()
+{
+	return _program;
+}
+
+bool	Worker::isDraining()
+{
+	return _draining;
+}
+
+bool	Worker::isOverloaded()
+{
+	return _overloaded;
+}
+
+const std::string	&Worker::getOverloadResponse()
+{
+	return _overloadResponse;
+}
+
+const HeadLimits	&Worker::getHeadLimits()
+{
+	return _headLimits;
+}
+
+const LatencyHistogram	&Worker::getLoopLag()
+{
+	return _loopLag;
+}
+
+int	Worker::getId()
+{
+	return _id;
+}
+
+uint32_t	Worker::getEdgeTriggerFlag()
+{
+	return _edgeTriggerFlag;
+}
+
+bool	Worker::isEdgeTriggered()
+{
+	return _edgeTriggerFlag != 0;
+}
+
+uint32_t	Worker::getSocketEventFlags()
+{
+	return _socketEventFlags;
+}
+
+bool	Worker::isCompletionBased()
+{
+	return _eventBackend->isCompletionBased();
+}
+
+int	Worker::getAcceptBudget()
+{
+	return _program.getGlobalConfig().acceptBudget;
+}
+
+IEventBackend	&Worker::getEventBackend()
+{
+	return *_eventBackend;
+}
+
+TimerWheel	&Worker::getTimerWheel()
+{
+	return _timerWheel;
+}
+
+ClientPool	&Worker::getClientPool()
+{
+	return _clientPool;
+}
+
+std::chrono::seconds	Worker::getPhaseTimeout(TimerPhase phase)
+{
+	GlobalConfig	&config = _program.getGlobalConfig();
+
+	switch (phase)
+	{
+		case TimerPhase::HEADER: return std::chrono::seconds(config.clientHeaderTimeout);
+		case TimerPhase::BODY: return std::chrono::seconds(config.clientBodyTimeout);
+		case TimerPhase::KEEPALIVE: return std::chrono::seconds(config.keepaliveTimeout);
+		case TimerPhase::SEND: return std::chrono::seconds(config.sendTimeout);
+		case TimerPhase::CGI: return std::chrono::seconds(config.cgiTimeout);
+	}
+	return std::chrono::seconds(config.keepaliveTimeout);
+}
+
+FdClientTable	&Worker::getClientsTable()
+{
+	return _clientsTable;
+}
+
+FdEpollOwnerTable	&Worker::getHandlersTable()
+{
+	return _handlersTable;
+}
+
+IpPortDeq &Worker::getAddrPortVec()
+{
+	return _addrPortVec;
+}
+
+// Constructors + Destructor
+
+Worker::Worker(Program &program, int id)
+	: _program{program}
+	, _id{id}
+	, _servInfo{nullptr}
+	, _wakeFd{-1}
+	, _configGeneration{0}
+	, _drainRequested{false}
+	, _draining{false}
+	, _events(program.getGlobalConfig().maxEvents)
+	, _timerWheel{g_current_time}
+	, _pausedListeners{0}
+	, _clientPool(program.getGlobalConfig().clientPoolSize)
+	, _edgeTriggerFlag{program.getGlobalConfig().edgeTriggered ? static_cast<uint32_t>(EPOLLET) : 0}
+	, _socketEventFlags{_edgeTriggerFlag}
+	, _smoothedLagUs{0}
+	, _overloaded{false}
+	, _lastBatchEnd{g_current_time}
+{
+	_overloadResponse = "HTTP/1.1 503 Service Unavailable\r\n"
+		"Retry-After: " + std::to_string(program.getGlobalConfig().overloadRetryAfter) + "\r\n"
+		"Content-Length: 0\r\n"
+		"Server: webserv/1.0\r\n"
+		"Connection: close\r\n"
+		"\r\n";
+	_headLimits.requestLine = program.getGlobalConfig().maxRequestLine;
+	_headLimits.headerLine = program.getGlobalConfig().maxHeaderLine;
+	_headLimits.headerSize = program.getGlobalConfig().maxHeaderSize;
+}
+
+Worker::~Worker()
+{
+	join();
+	freeaddrinfo(_servInfo);
+	if (_wakeFd != -1)
+		close(_wakeFd);
+}
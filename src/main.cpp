@@ -10,17 +10,21 @@ int	main(int ac, char **av)
 		return 0;
 	}
 
+	Logger::start();
+	program.setCommandLine(av);
 	try
 	{
 		program.parseConfFile(av[1]);
 		program.initSockets();
-		program.waitEpollEvent();
+		program.runWorkers();
 	}
 	catch (std::exception& e)
 	{
+		Logger::stop();
 		std::cerr << "Fatal Error: " << e.what() << std::endl;
 		return 1;
 	}
 
+	Logger::stop();
 	return 0;
 }
@@ -0,0 +1,182 @@
+#include "Test.hpp"
+#include "HttpRequestParser.hpp"
+
+#include <string>
+
+TEST(parsesCompleteHead)
+{
+	HttpRequestParser	parser;
+	std::string			buffer = "POST /upload/a.txt?x=1 HTTP/1.1\r\n"
+		"Host: localhost:8080\r\n"
+		"content-type:  text/plain \r\n"
+		"Content-Length: 42\r\n"
+		"Connection: keep-alive\r\n"
+		"X-Unknown: ignored\r\n"
+		"\r\n"
+		"body";
+
+	CHECK(parser.feed(buffer));
+	RequestHead	head = parser.getHead(buffer);
+	CHECK(head.method == HttpMethod::POST);
+	CHECK_EQ(head.target, "/upload/a.txt?x=1");
+	CHECK_EQ(head.version, "HTTP/1.1");
+	CHECK_EQ(head.host, "localhost:8080");
+	CHECK_EQ(head.contentType, "text/plain");
+	CHECK_EQ(head.connection, "keep-alive");
+	CHECK_EQ(head.contentLength, 42u);
+	CHECK_EQ(parser.getHeadEnd(), buffer.size() - 4);
+	CHECK_EQ(parser.getError().statusCode, 0);
+}
+
+TEST(acceptsBareLineFeeds)
+{
+	HttpRequestParser	parser;
+	std::string			buffer = "GET / HTTP/1.1\nHost: a\n\n";
+
+	CHECK(parser.feed(buffer));
+	CHECK_EQ(parser.getHead(buffer).host, "a");
+	CHECK_EQ(parser.getHeadEnd(), buffer.size());
+}
+
+TEST(skipsLeadingEmptyLines)
+{
+	HttpRequestParser	parser;
+	std::string			buffer = "\r\n\r\nGET /index.html HTTP/1.1\r\n\r\n";
+
+	CHECK(parser.feed(buffer));
+	CHECK(parser.getHead(buffer).method == HttpMethod::GET);
+	CHECK_EQ(parser.getHead(buffer).target, "/index.html");
+}
+
+// The same head fed one byte at a time must parse exactly like the whole
+TEST(resumesAcrossPartialFeeds)
+{
+	std::string			full = "DELETE /upload/f HTTP/1.1\r\n"
+		"Host: example\r\n"
+		"Expect: 100-continue\r\n"
+		"Transfer-Encoding: chunked\r\n"
+		"\r\n";
+	HttpRequestParser	parser;
+	std::string			buffer;
+
+	for (size_t i = 0; i < full.size(); ++i)
+	{
+		// A fresh copy each time: spans are offsets and survive the move
+		buffer = full.substr(0, i + 1);
+		bool	done = parser.feed(buffer);
+		CHECK_EQ(done, i + 1 == full.size());
+	}
+	RequestHead	head = parser.getHead(buffer);
+	CHECK(head.method == HttpMethod::DELETE);
+	CHECK_EQ(head.target, "/upload/f");
+	CHECK_EQ(head.host, "example");
+	CHECK_EQ(head.expect, "100-continue");
+	CHECK_EQ(head.transferEncoding, "chunked");
+	CHECK_EQ(parser.getHeadEnd(), full.size());
+}
+
+TEST(unknownMethodIsNotAnError)
+{
+	HttpRequestParser	parser;
+	std::string			buffer = "PATCH / HTTP/1.1\r\n\r\n";
+
+	CHECK(parser.feed(buffer));
+	CHECK(parser.getHead(buffer).method == HttpMethod::UNKNOWN);
+}
+
+TEST(rejectsMalformedRequestLines)
+{
+	const char	*lines[] = {
+		"GET\r\n\r\n",
+		"GET /\r\n\r\n",
+		" GET / HTTP/1.1\r\n\r\n",
+		"GET  HTTP/1.1\r\n\r\n",
+		"G(T / HTTP/1.1\r\n\r\n",
+	};
+
+	for (const char *line : lines)
+	{
+		HttpRequestParser	parser;
+		CHECK(!parser.feed(line));
+		CHECK_EQ(parser.getError().statusCode, 400);
+	}
+}
+
+TEST(rejectsMalformedHeaders)
+{
+	const char	*heads[] = {
+		"GET / HTTP/1.1\r\nNo colon\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost : a\r\n\r\n",
+		"GET / HTTP/1.1\r\n: empty\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length: 12a\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length:\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+	};
+
+	for (const char *head : heads)
+	{
+		HttpRequestParser	parser;
+		CHECK(!parser.feed(head));
+		CHECK_EQ(parser.getError().statusCode, 400);
+	}
+}
+
+// A failed parser stays failed, whatever arrives after the bad line
+TEST(failureIsSticky)
+{
+	HttpRequestParser	parser;
+	std::string			buffer = "GET / HTTP/1.1\r\nbad\r\n";
+
+	CHECK(!parser.feed(buffer));
+	buffer += "Host: a\r\n\r\n";
+	CHECK(!parser.feed(buffer));
+	CHECK_EQ(parser.getError().statusCode, 400);
+}
+
+TEST(enforcesHeadLimits)
+{
+	HeadLimits	limits;
+
+	limits.requestLine = 32;
+	limits.headerLine = 24;
+	limits.headerSize = 64;
+
+	HttpRequestParser	longLine;
+	longLine.setLimits(limits);
+	CHECK(!longLine.feed("GET /" + std::string(40, 'a') + " HTTP/1.1\r\n\r\n"));
+	CHECK_EQ(longLine.getError().statusCode, 414);
+
+	// Cut off on the partial line, before its newline ever arrives
+	HttpRequestParser	trickle;
+	trickle.setLimits(limits);
+	CHECK(!trickle.feed("GET /" + std::string(40, 'a')));
+	CHECK_EQ(trickle.getError().statusCode, 414);
+
+	HttpRequestParser	longField;
+	longField.setLimits(limits);
+	CHECK(!longField.feed("GET / HTTP/1.1\r\nX-Long: " + std::string(30, 'b') + "\r\n\r\n"));
+	CHECK_EQ(longField.getError().statusCode, 431);
+
+	HttpRequestParser	bigHead;
+	bigHead.setLimits(limits);
+	std::string	head = "GET / HTTP/1.1\r\n";
+	for (int i = 0; i < 8; ++i)
+		head += "X-" + std::to_string(i) + ": v\r\n";
+	CHECK(!bigHead.feed(head + "\r\n"));
+	CHECK_EQ(bigHead.getError().statusCode, 431);
+}
+
+TEST(resetKeepsLimits)
+{
+	HttpRequestParser	parser;
+	HeadLimits			limits;
+
+	limits.requestLine = 16;
+	parser.setLimits(limits);
+	CHECK(parser.feed("GET / HTTP/1.1\r\n\r\n"));
+	parser.reset();
+	CHECK_EQ(parser.getHeadEnd(), 0u);
+	CHECK(!parser.feed("GET /" + std::string(20, 'a') + " HTTP/1.1\r\n\r\n"));
+	CHECK_EQ(parser.getError().statusCode, 414);
+}
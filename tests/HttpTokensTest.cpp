@@ -0,0 +1,52 @@
+#include "Test.hpp"
+#include "HttpTokens.hpp"
+
+#include <string>
+
+TEST(methodLookupIsCaseSensitive)
+{
+	for (HttpMethod method : {HttpMethod::GET, HttpMethod::POST, HttpMethod::DELETE})
+	{
+		std::string	name(tokens::methodName(method));
+		CHECK(tokens::lookupMethod(name) == method);
+		name[0] = static_cast<char>(name[0] - 'A' + 'a');
+		CHECK(tokens::lookupMethod(name) == HttpMethod::UNKNOWN);
+	}
+	for (const char *other : {"", "G", "GETS", "PUT", "HEAD", "OPTIONS", "DELET", "POST "})
+		CHECK(tokens::lookupMethod(other) == HttpMethod::UNKNOWN);
+}
+
+// Every header name in any letter case finds its id; a name one byte off,
+// with a trailing space or missing its first letter doesn't
+TEST(headerLookupIgnoresCase)
+{
+	const tokens::Token<HeaderId>	headers[] = {
+		{"Host", HeaderId::HOST},
+		{"Content-Type", HeaderId::CONTENT_TYPE},
+		{"Content-Length", HeaderId::CONTENT_LENGTH},
+		{"Transfer-Encoding", HeaderId::TRANSFER_ENCODING},
+		{"Connection", HeaderId::CONNECTION},
+		{"Expect", HeaderId::EXPECT},
+	};
+
+	for (const tokens::Token<HeaderId> &header : headers)
+	{
+		std::string	lower(header.name);
+		std::string	upper(header.name);
+		for (char &c : lower)
+			c = tokens::foldCase(c);
+		for (char &c : upper)
+			c = (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+		CHECK(tokens::lookupHeader(header.name) == header.id);
+		CHECK(tokens::lookupHeader(lower) == header.id);
+		CHECK(tokens::lookupHeader(upper) == header.id);
+
+		std::string	nearMiss(header.name);
+		nearMiss.back() = nearMiss.back() == 'x' ? 'y' : 'x';
+		CHECK(tokens::lookupHeader(nearMiss) == HeaderId::UNKNOWN);
+		CHECK(tokens::lookupHeader(std::string(header.name) + " ") == HeaderId::UNKNOWN);
+		CHECK(tokens::lookupHeader(header.name.substr(1)) == HeaderId::UNKNOWN);
+	}
+	for (const char *other : {"", "X-Host", "Accept", "Content-Encoding", "Keep-Alive", "Upgrade"})
+		CHECK(tokens::lookupHeader(other) == HeaderId::UNKNOWN);
+}
@@ -0,0 +1,216 @@
+#include "Test.hpp"
+#include "Scan.hpp"
+
+#include <cstring>
+#include <random>
+#include <string>
+
+// Byte-at-a-time references, written from the contracts in Scan.hpp
+namespace
+{
+
+bool	isToken(unsigned char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+		|| (c != 0 && strchr("!#$%&'*+-.^_`|~", c));
+}
+
+bool	isHex(unsigned char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+size_t	findCrlfReference(const std::string &s)
+{
+	size_t	found = s.find("\r\n");
+
+	return found == std::string::npos ? s.size() : found;
+}
+
+size_t	findDoubleCrlfReference(const std::string &s)
+{
+	size_t	found = s.find("\r\n\r\n");
+
+	return found == std::string::npos ? s.size() : found;
+}
+
+size_t	tokenLengthReference(const std::string &s)
+{
+	size_t	i = 0;
+
+	while (i < s.size() && isToken(s[i]))
+		++i;
+	return i;
+}
+
+size_t	hexLengthReference(const std::string &s)
+{
+	size_t	i = 0;
+
+	while (i < s.size() && isHex(s[i]))
+		++i;
+	return i;
+}
+
+size_t	pathCleanLengthReference(const std::string &s)
+{
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		unsigned char	c = s[i];
+		if (c == '%' || c < 0x20 || c == 0x7f)
+			return i;
+		if (c == '/' && i + 1 < s.size() && (s[i + 1] == '/' || s[i + 1] == '.'))
+			return i;
+	}
+	return s.size();
+}
+
+// Runs of "good" bytes with the occasional one from the other alphabet, so
+// the first stop falls at every offset within and across vector blocks
+std::string	randomInput(std::mt19937 &rng, const std::string &good, const std::string &other)
+{
+	std::uniform_int_distribution<size_t>	length(0, 200);
+	std::uniform_int_distribution<int>		pick(0, 63);
+	std::string								s(length(rng), '\0');
+
+	for (char &c : s)
+	{
+		const std::string	&alphabet = pick(rng) == 0 ? other : good;
+		c = alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(rng)];
+	}
+	return s;
+}
+
+// Checks every kernel set this CPU can run against the references, with
+// the input at 0..3 bytes past an aligned address
+template <typename Check>
+void	forEachImplementation(const std::string &input, Check check)
+{
+	for (const char *name : scan::implementations())
+	{
+		CHECK(scan::useImplementation(name));
+		for (size_t shift = 0; shift < 4; ++shift)
+		{
+			alignas(32) char	storage[512];
+			memcpy(storage + shift, input.data(), input.size());
+			check(name, storage + shift);
+		}
+	}
+	scan::useImplementation(scan::implementations().front());
+}
+
+const int	g_rounds = 3000;
+
+}
+
+TEST(scalarIsAlwaysAvailable)
+{
+	std::vector<const char*>	names = scan::implementations();
+
+	CHECK(!names.empty());
+	CHECK_EQ(std::string(names.front()), std::string(scan::implementation()));
+	CHECK_EQ(std::string(names.back()), "scalar");
+	CHECK(!scan::useImplementation("altivec"));
+}
+
+TEST(findCrlfKernelsAgree)
+{
+	std::mt19937	rng(1);
+
+	for (int round = 0; round < g_rounds; ++round)
+	{
+		std::string	input = randomInput(rng, "ab \r\n:", "\r\n");
+		forEachImplementation(input, [&](const char *name, const char *data) {
+			size_t	expected = findCrlfReference(input);
+			size_t	found = scan::findCrlf(data, input.size());
+			if (found != expected)
+				std::cerr << name << ": findCrlf\n";
+			CHECK_EQ(found, expected);
+			CHECK_EQ(scan::findDoubleCrlf(data, input.size()), findDoubleCrlfReference(input));
+		});
+	}
+}
+
+TEST(tokenLengthKernelsAgree)
+{
+	std::mt19937	rng(2);
+	std::string		tokens = "azAZ09!#$%&'*+-.^_`|~";
+	std::string		separators = " \t\"(),/:;<=>?@[\\]{}\x7f\x80\xff";
+
+	separators.push_back('\0');
+	for (int round = 0; round < g_rounds; ++round)
+	{
+		std::string	input = randomInput(rng, tokens, separators);
+		forEachImplementation(input, [&](const char *name, const char *data) {
+			size_t	length = scan::tokenLength(data, input.size());
+			if (length != tokenLengthReference(input))
+				std::cerr << name << ": tokenLength\n";
+			CHECK_EQ(length, tokenLengthReference(input));
+		});
+	}
+}
+
+TEST(parseHexKernelsAgree)
+{
+	std::mt19937	rng(3);
+
+	for (int round = 0; round < g_rounds; ++round)
+	{
+		std::string	input = randomInput(rng, "0123456789abcdefABCDEF", "gG;\r \x80");
+		input.resize(input.size() % 24);
+		size_t		digits = hexLengthReference(input);
+		uint64_t	expected = digits > 0 && digits <= 16 ? std::stoull(input.substr(0, digits), nullptr, 16) : 0;
+		forEachImplementation(input, [&](const char *name, const char *data) {
+			uint64_t	value = 0;
+			size_t		parsed = scan::parseHex(data, input.size(), value);
+			if (parsed != (digits <= 16 ? digits : 0))
+				std::cerr << name << ": parseHex\n";
+			CHECK_EQ(parsed, digits <= 16 ? digits : 0);
+			if (parsed)
+				CHECK_EQ(value, expected);
+		});
+	}
+}
+
+TEST(pathCleanLengthKernelsAgree)
+{
+	std::mt19937	rng(4);
+	std::string		unsafe = "%./\x01\x1f\x7f";
+
+	unsafe.push_back('\0');
+	for (int round = 0; round < g_rounds; ++round)
+	{
+		std::string	input = randomInput(rng, "/ab.-_~\x80\xff", unsafe);
+		forEachImplementation(input, [&](const char *name, const char *data) {
+			size_t	length = scan::pathCleanLength(data, input.size());
+			if (length != pathCleanLengthReference(input))
+				std::cerr << name << ": pathCleanLength\n";
+			CHECK_EQ(length, pathCleanLengthReference(input));
+		});
+	}
+}
+
+// A match straddling the end of a vector block, and one cut off by the end
+TEST(scanBlockBoundaries)
+{
+	for (size_t at = 0; at < 70; ++at)
+	{
+		std::string	crlf(at, 'x');
+		crlf += "\r\n";
+		std::string	truncated(at, 'x');
+		truncated += "\r";
+		std::string	path(at, 'a');
+		path += "/.";
+		forEachImplementation(crlf, [&](const char *, const char *data) {
+			CHECK_EQ(scan::findCrlf(data, crlf.size()), at);
+			CHECK_EQ(scan::findCrlf(data, crlf.size() - 1), crlf.size() - 1);
+		});
+		forEachImplementation(truncated, [&](const char *, const char *data) {
+			CHECK_EQ(scan::findCrlf(data, truncated.size()), truncated.size());
+		});
+		forEachImplementation(path, [&](const char *, const char *data) {
+			CHECK_EQ(scan::pathCleanLength(data, path.size()), at);
+			CHECK_EQ(scan::pathCleanLength(data, path.size() - 1), path.size() - 1);
+		});
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+// Minimal self-registering test harness: each TEST body runs once from
+// main(), and a failed CHECK reports its location without stopping the
+// rest of the suite.
+struct TestCase
+{
+	const char	*name;
+	void		(*run)();
+};
+
+std::vector<TestCase>	&testRegistry();
+int						&testFailures();
+bool					registerTest(const char *name, void (*run)());
+
+#define TEST(name) \
+	static void	name(); \
+	static bool	name##Registered = registerTest(#name, name); \
+	static void	name()
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			++testFailures(); \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(actual, expected) \
+	do { \
+		auto	actualValue = (actual); \
+		auto	expectedValue = (expected); \
+		if (!(actualValue == expectedValue)) \
+		{ \
+			++testFailures(); \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is " << actualValue \
+				<< ", expected " << expectedValue << "\n"; \
+		} \
+	} while (0)
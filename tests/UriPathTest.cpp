@@ -0,0 +1,103 @@
+#include "Test.hpp"
+#include "UriPath.hpp"
+#include "Scan.hpp"
+
+#include <string>
+
+namespace
+{
+
+struct PathCase
+{
+	const char	*raw;
+	const char	*canonical;
+};
+
+struct RejectedCase
+{
+	const char	*raw;
+	int			statusCode;
+};
+
+// The clean-prefix scan decides what is copied as is, so every case runs
+// under each kernel set
+template <typename Check>
+void	forEachImplementation(Check check)
+{
+	for (const char *name : scan::implementations())
+	{
+		CHECK(scan::useImplementation(name));
+		check();
+	}
+	scan::useImplementation(scan::implementations().front());
+}
+
+}
+
+TEST(normalizePathCanonicalizes)
+{
+	const PathCase	cases[] = {
+		{"/", "/"},
+		{"/index.html", "/index.html"},
+		{"/upload/", "/upload/"},
+		{"/a%20b.txt", "/a b.txt"},
+		{"/%41%62c", "/Abc"},
+		{"/caf%C3%A9", "/caf\xC3\xA9"},
+		{"//a///b/", "/a/b/"},
+		{"/a/./b/../c", "/a/c"},
+		{"/a/b/c/../../d", "/a/d"},
+		{"/a/..", "/"},
+		{"/a/%2e/b", "/a/b"},
+		{"/a/%2E%2E/b", "/b"},
+		{"/x/y/z/.", "/x/y/z/"},
+		{"/x/y/z/..", "/x/y/"},
+		{"/a/b/.hidden", "/a/b/.hidden"},
+		{"/..foo/bar", "/..foo/bar"},
+		{"/very/long/clean/path/segment/that/goes/beyond/thirty/two/bytes/file.html",
+			"/very/long/clean/path/segment/that/goes/beyond/thirty/two/bytes/file.html"},
+		{"/very/long/clean/path/segment/that/goes/beyond/thirty/two/bytes//file.html",
+			"/very/long/clean/path/segment/that/goes/beyond/thirty/two/bytes/file.html"},
+		{"/abc/def/ghi/jkl/mno/pqr/stu%41", "/abc/def/ghi/jkl/mno/pqr/stuA"},
+	};
+
+	forEachImplementation([&] {
+		for (const PathCase &test : cases)
+		{
+			std::string	out = "stale";
+			HttpError	error = uri::normalizePath(test.raw, out);
+			CHECK_EQ(error.statusCode, 0);
+			CHECK_EQ(out, test.canonical);
+		}
+	});
+}
+
+TEST(normalizePathRejects)
+{
+	const RejectedCase	cases[] = {
+		{"", 400},
+		{"a/b", 400},
+		{"/..", 400},
+		{"/a/../..", 400},
+		{"/%2e%2e/x", 400},
+		{"/a%2Fb", 400},
+		{"/a/b/..%2f", 400},
+		{"/a%zz", 400},
+		{"/a%2", 400},
+		{"/a%", 400},
+		{"/a%00", 400},
+		{"/a\x01", 400},
+		{"/a\x7f", 400},
+		{"/a/%7F", 400},
+	};
+
+	forEachImplementation([&] {
+		for (const RejectedCase &test : cases)
+		{
+			std::string	out;
+			HttpError	error = uri::normalizePath(test.raw, out);
+			if (error.statusCode != test.statusCode)
+				std::cerr << "normalizePath(\"" << test.raw << "\") gave " << out << "\n";
+			CHECK_EQ(error.statusCode, test.statusCode);
+		}
+	});
+}
@@ -0,0 +1,203 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Closed-loop load generator: each connection sends one request, waits for
+// the whole response and sends the next one, reconnecting whenever the
+// server closes. Prints requests/s and the status codes seen.
+namespace
+{
+
+struct Connection
+{
+	int			fd = -1;
+	std::string	response;
+	size_t		sent = 0;
+};
+
+struct Totals
+{
+	size_t					completed = 0;
+	size_t					errors = 0;
+	std::map<int, size_t>	statuses;
+};
+
+sockaddr_in	g_address;
+std::string	g_request;
+int			g_epollFd = -1;
+
+bool	openConnection(Connection &conn)
+{
+	conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (conn.fd < 0)
+		return false;
+	conn.response.clear();
+	conn.sent = 0;
+	if (connect(conn.fd, reinterpret_cast<sockaddr*>(&g_address), sizeof(g_address)) < 0
+		&& errno != EINPROGRESS)
+	{
+		close(conn.fd);
+		conn.fd = -1;
+		return false;
+	}
+	epoll_event	ev{};
+	ev.events = EPOLLOUT;
+	ev.data.ptr = &conn;
+	epoll_ctl(g_epollFd, EPOLL_CTL_ADD, conn.fd, &ev);
+	return true;
+}
+
+void	closeConnection(Connection &conn)
+{
+	close(conn.fd);
+	conn.fd = -1;
+}
+
+void	setInterest(Connection &conn, uint32_t events)
+{
+	epoll_event	ev{};
+	ev.events = events;
+	ev.data.ptr = &conn;
+	epoll_ctl(g_epollFd, EPOLL_CTL_MOD, conn.fd, &ev);
+}
+
+// Returns the length of the first complete response, or 0 while it is
+// still arriving; sets keepAlive from its Connection header
+size_t	responseLength(const std::string &response, bool &keepAlive)
+{
+	size_t	headEnd = response.find("\r\n\r\n");
+	if (headEnd == std::string::npos)
+		return 0;
+	std::string	head = response.substr(0, headEnd);
+	size_t		contentLength = 0;
+	size_t		field = head.find("Content-Length:");
+	if (field != std::string::npos)
+		contentLength = std::strtoul(head.c_str() + field + strlen("Content-Length:"), nullptr, 10);
+	keepAlive = head.find("Connection: close") == std::string::npos;
+	if (response.size() < headEnd + 4 + contentLength)
+		return 0;
+	return headEnd + 4 + contentLength;
+}
+
+void	recordResponse(const std::string &response, Totals &totals)
+{
+	++totals.completed;
+	if (response.compare(0, 9, "HTTP/1.1 ") == 0)
+		++totals.statuses[std::atoi(response.c_str() + 9)];
+	else
+		++totals.errors;
+}
+
+// Drives one connection as far as it can go without blocking
+void	handleEvent(Connection &conn, uint32_t events, Totals &totals)
+{
+	if (conn.sent < g_request.size())
+	{
+		ssize_t	sent = send(conn.fd, g_request.data() + conn.sent, g_request.size() - conn.sent, MSG_NOSIGNAL);
+		if (sent < 0 && errno != EAGAIN)
+		{
+			++totals.errors;
+			closeConnection(conn);
+			openConnection(conn);
+			return;
+		}
+		if (sent > 0)
+			conn.sent += static_cast<size_t>(sent);
+		if (conn.sent == g_request.size())
+			setInterest(conn, EPOLLIN);
+		return;
+	}
+	if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+		return;
+
+	char	buffer[16384];
+	ssize_t	readBytes = recv(conn.fd, buffer, sizeof(buffer), 0);
+	if (readBytes < 0 && errno == EAGAIN)
+		return;
+	if (readBytes > 0)
+		conn.response.append(buffer, static_cast<size_t>(readBytes));
+
+	bool	keepAlive = false;
+	size_t	length = responseLength(conn.response, keepAlive);
+	if (length)
+	{
+		recordResponse(conn.response, totals);
+		conn.response.erase(0, length);
+	}
+	if (length && keepAlive && readBytes > 0)
+	{
+		conn.sent = 0;
+		setInterest(conn, EPOLLOUT);
+		return;
+	}
+	if (length || readBytes <= 0)
+	{
+		if (!length)
+			++totals.errors;
+		closeConnection(conn);
+		openConnection(conn);
+	}
+}
+
+}
+
+int	main(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: " << argv[0] << " <ipv4> <port> <path> [connections] [seconds]\n";
+		return 1;
+	}
+	int		connections = argc > 4 ? std::atoi(argv[4]) : 32;
+	int		seconds = argc > 5 ? std::atoi(argv[5]) : 5;
+
+	g_address.sin_family = AF_INET;
+	g_address.sin_port = htons(static_cast<uint16_t>(std::atoi(argv[2])));
+	if (inet_pton(AF_INET, argv[1], &g_address.sin_addr) != 1 || connections <= 0 || seconds <= 0)
+	{
+		std::cerr << "Invalid address, connection count or duration\n";
+		return 1;
+	}
+	g_request = std::string("GET ") + argv[3] + " HTTP/1.1\r\nHost: " + argv[1]
+		+ "\r\nConnection: keep-alive\r\n\r\n";
+	g_epollFd = epoll_create1(0);
+
+	std::vector<Connection>	pool(static_cast<size_t>(connections));
+	Totals					totals;
+	for (Connection &conn : pool)
+		openConnection(conn);
+
+	auto	start = std::chrono::steady_clock::now();
+	auto	deadline = start + std::chrono::seconds(seconds);
+	epoll_event	events[256];
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		int	ready = epoll_wait(g_epollFd, events, 256, 100);
+		for (int i = 0; i < ready; ++i)
+			handleEvent(*static_cast<Connection*>(events[i].data.ptr), events[i].events, totals);
+	}
+	double	elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << totals.completed << " requests in " << elapsed << "s: "
+		<< static_cast<long>(totals.completed / elapsed) << " req/s";
+	for (const auto &[status, count] : totals.statuses)
+		std::cout << ", " << status << ": " << count;
+	std::cout << ", errors: " << totals.errors << "\n";
+	for (Connection &conn : pool)
+		if (conn.fd >= 0)
+			close(conn.fd);
+	close(g_epollFd);
+	return totals.completed == 0;
+}
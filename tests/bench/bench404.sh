@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# Hammers a path that doesn't exist and reports requests/s for this tree
+# and, given a git ref, for that tree as well, so the two can be compared:
+#   make bench                 this tree only
+#   make bench BASE=<git ref>  <git ref> first, then this tree
+# BENCH_PATH, BENCH_CONNECTIONS and BENCH_SECONDS override the defaults.
+# Each tree runs its own conf/default.conf, which listens on port 8080.
+set -euo pipefail
+
+root=$(cd "$(dirname "$0")/../.." && pwd)
+client="$root/webserv_bench"
+path=${BENCH_PATH:-/bench-missing-page}
+connections=${BENCH_CONNECTIONS:-32}
+seconds=${BENCH_SECONDS:-5}
+port=8080
+
+run() {
+	local tree=$1 label=$2 pid
+
+	(cd "$tree" && exec ./webserv conf/default.conf >/dev/null 2>&1) &
+	pid=$!
+	until (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null; do
+		if ! kill -0 "$pid" 2>/dev/null; then
+			echo "$label: server did not start" >&2
+			return 1
+		fi
+		sleep 0.1
+	done
+	printf '%-16s' "$label:"
+	"$client" 127.0.0.1 "$port" "$path" "$connections" "$seconds" || true
+	kill "$pid"
+	wait "$pid" 2>/dev/null || true
+}
+
+if [ -n "${1:-}" ]; then
+	base="$root/objs/bench/$(git -C "$root" rev-parse --short "$1")"
+	if [ ! -x "$base/webserv" ]; then
+		mkdir -p "$base"
+		git -C "$root" archive "$1" | tar -x -C "$base"
+		make -C "$base" -j"$(nproc)" webserv >/dev/null
+	fi
+	run "$base" "$1"
+fi
+run "$root" "this tree"
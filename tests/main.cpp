@@ -0,0 +1,38 @@
+#include "Test.hpp"
+
+std::vector<TestCase>	&testRegistry()
+{
+	static std::vector<TestCase>	registry;
+
+	return registry;
+}
+
+int	&testFailures()
+{
+	static int	failures = 0;
+
+	return failures;
+}
+
+bool	registerTest(const char *name, void (*run)())
+{
+	testRegistry().push_back({name, run});
+	return true;
+}
+
+int	main()
+{
+	int	failedTests = 0;
+
+	for (TestCase &test : testRegistry())
+	{
+		int	before = testFailures();
+		test.run();
+		bool	passed = testFailures() == before;
+		if (!passed)
+			++failedTests;
+		std::cout << (passed ? "[ OK ] " : "[FAIL] ") << test.name << "\n";
+	}
+	std::cout << testRegistry().size() - failedTests << "/" << testRegistry().size() << " tests passed\n";
+	return failedTests ? 1 : 0;
+}
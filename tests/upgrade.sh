@@ -0,0 +1,66 @@
+#!/usr/bin/env bash
+# Upgrades the binary in place (SIGUSR2) while webserv_bench keeps asking
+# for a missing page, which is answered on a fresh connection every time,
+# so each accept queue is handed over with connections in it. Runs with
+# the worker_threads count unchanged, raised and lowered across the
+# upgrade, and fails if the load saw an error or the old process stayed.
+set -euo pipefail
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+conf=$(mktemp --suffix=.conf)
+load=$(mktemp)
+port=8080
+trap 'rm -f "$conf" "$load"' EXIT
+cd "$root"
+
+waitForPort() {
+	for _ in $(seq 50); do
+		(exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null && return 0
+		sleep 0.1
+	done
+	return 1
+}
+
+# A zombie still answers kill -0, so the state is read instead
+alive() {
+	[ -r "/proc/$1/stat" ] && [ "$(cut -d' ' -f3 "/proc/$1/stat")" != Z ]
+}
+
+upgrade() {
+	local from=$1 to=$2 old new loadPid result=ok
+
+	sed "s/^worker_threads .*;/worker_threads $from;/" conf/default.conf > "$conf"
+	(exec ./webserv "$conf" >/dev/null 2>&1 &)
+	waitForPort
+	old=$(pgrep -n -x webserv)
+	./webserv_bench 127.0.0.1 "$port" /upgrade-missing-page 64 4 > "$load" &
+	loadPid=$!
+	sleep 1
+	sed -i "s/^worker_threads .*;/worker_threads $to;/" "$conf"
+	kill -USR2 "$old"
+	wait "$loadPid" || true
+	for _ in $(seq 100); do
+		alive "$old" || break
+		sleep 0.1
+	done
+	new=$(pgrep -n -x webserv || true)
+	if alive "$old" || [ -z "$new" ]; then
+		result="FAILED, no takeover"
+	elif ! grep -q "errors: 0$" "$load"; then
+		result=FAILED
+	fi
+	echo "$from -> $to workers: $result: $(cat "$load")"
+	pkill -x webserv || true
+	while pgrep -x webserv >/dev/null; do sleep 0.1; done
+	[ "$result" = ok ]
+}
+
+if pgrep -x webserv >/dev/null; then
+	echo "a webserv is already running" >&2
+	exit 1
+fi
+status=0
+upgrade 4 4 || status=1
+upgrade 1 4 || status=1
+upgrade 4 1 || status=1
+exit $status